@@ -0,0 +1,97 @@
+/*
+mwer : multi-word expressions extractor
+Copyright (C) 2013  Tom Bosc
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "bloom_filter.h"
+
+namespace mwer{
+/**
+* @param nKeys Number of keys that will be inserted
+* @param bitsPerKey Size of the filter per key
+*/
+BloomFilter::BloomFilter(size_t nKeys, int bitsPerKey) :
+	nBlocks((nKeys * bitsPerKey + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK)
+{
+	if (nBlocks == 0) {
+		nBlocks = 1;
+	}
+
+	words.resize(nBlocks * WORDS_PER_BLOCK, 0);
+}
+
+
+
+/**
+* @brief Spread the bits of a hash (finalizer of MurmurHash3)
+*/
+uint64_t BloomFilter::mix(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+
+
+/**
+* @brief Insert a key
+*
+* @param hash hash of the key
+*/
+void BloomFilter::insert(size_t hash)
+{
+	uint64_t h = mix(hash);
+	uint64_t *block = &words[((uint32_t) h % nBlocks) * WORDS_PER_BLOCK];
+	// bit positions in the block, by double hashing
+	uint32_t h1 = h >> 32;
+	uint32_t h2 = ((h * 0x9e3779b97f4a7c15ULL) >> 32) | 1;
+
+	for (int i = 0; i < N_HASHES; ++i) {
+		uint32_t bit = (h1 + i * h2) % BITS_PER_BLOCK;
+		block[bit / 64] |= (uint64_t) 1 << (bit % 64);
+	}
+}
+
+
+
+/**
+* @param hash hash of the key
+*
+* @return false if the key has not been inserted, true if it probably has
+*/
+bool BloomFilter::mayContain(size_t hash) const
+{
+	uint64_t h = mix(hash);
+	const uint64_t *block = &words[((uint32_t) h % nBlocks) * WORDS_PER_BLOCK];
+	uint32_t h1 = h >> 32;
+	uint32_t h2 = ((h * 0x9e3779b97f4a7c15ULL) >> 32) | 1;
+
+	for (int i = 0; i < N_HASHES; ++i) {
+		uint32_t bit = (h1 + i * h2) % BITS_PER_BLOCK;
+
+		if ((block[bit / 64] & ((uint64_t) 1 << (bit % 64))) == 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+}
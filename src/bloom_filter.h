@@ -0,0 +1,55 @@
+/*
+mwer : multi-word expressions extractor
+Copyright (C) 2013  Tom Bosc
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef BLOOM_FILTER_H_
+#define BLOOM_FILTER_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace mwer{
+/**
+* @brief A blocked Bloom filter over hashed keys
+*
+* Each key sets its bits in a single block of 512 bits (a cache line), so
+* that a test costs at most one cache miss. A key that has been inserted is
+* always found; a key that has not is found with a probability of about 1%
+* with the default of 10 bits per key.
+*/
+class BloomFilter {
+	private:
+		static const int BITS_PER_BLOCK = 512;
+		static const int WORDS_PER_BLOCK = BITS_PER_BLOCK / 64;
+		static const int N_HASHES = 7;
+
+		std::vector<uint64_t> words;
+		size_t nBlocks;
+
+		static uint64_t mix(uint64_t h);
+
+	public:
+		BloomFilter(size_t nKeys, int bitsPerKey = 10);
+
+		void insert(size_t hash);
+		bool mayContain(size_t hash) const;
+};
+}
+
+#endif
@@ -125,6 +125,72 @@ bool Candidate::operator< (const AbstractCandidate &ac) const
 
 
 
+const std::vector<WordType *> &Candidate::getTypes() const
+{
+	return nW;
+}
+
+
+
+const std::vector<int> &Candidate::getParentIds() const
+{
+	return parentIds;
+}
+
+
+
+/**
+ * @brief Hash of the types and parent ids, based on the ids of the types
+ *
+ * Unlike @ref hash, it does not read the strings of the types. The types
+ * must be interned and not null.
+ */
+size_t Candidate::keyHash(const std::vector<WordType *> &v,
+						  const std::vector<int> &pid)
+{
+	size_t h = v.size();
+
+	for (auto &t : v) {
+		h = h * 1000003 + t->getId();
+	}
+
+	for (auto &p : pid) {
+		h = h * 31 + p;
+	}
+
+	return h;
+}
+
+
+
+size_t Candidate::keyHash() const
+{
+	return keyHash(nW, parentIds);
+}
+
+
+
+/**
+ * @brief Replace the types and parent ids of the candidate
+ *
+ * This is meant for a candidate used as a key to look up a set of
+ * candidates : the buffers are reused, so no allocation occurs once they
+ * are large enough.
+ *
+ * @param v types
+ * @param pid parent ids
+ * @param order number of undefined types minus one
+ */
+void Candidate::setKey(const std::vector<WordType *> &v,
+					   const std::vector<int> &pid, int order)
+{
+	nW.assign(v.begin(), v.end());
+	parentIds.assign(pid.begin(), pid.end());
+	this->order = order;
+}
+
+
+
 bool Candidate::regexpFilter(int factor, std::string regexp)
 {
 	std::vector<std::string> regexps = split(regexp, SEP_REGEXPS);
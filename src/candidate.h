@@ -57,6 +57,13 @@ class Candidate : public AbstractCandidate {
 		bool compare(const AbstractCandidate &) const;
 		bool operator<(const AbstractCandidate &a) const;
 		bool regexpFilter(int nFactors, std::string regexp);
+		const std::vector<WordType *> &getTypes() const;
+		const std::vector<int> &getParentIds() const;
+		size_t keyHash() const;
+		static size_t keyHash(const std::vector<WordType *> &v,
+							  const std::vector<int> &pid);
+		void setKey(const std::vector<WordType *> &v, const std::vector<int> &pid,
+					int order = 0);
 
 };
 }
@@ -26,15 +26,19 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <iostream>
 #include <fstream>
 #include <type_traits>
+#include <chrono>
 
 #include "candidate_filter.h"
 #include "context_candidate.h"
 #include "word_type.h"
 #include "token.h"
 #include "tree.h"
+#include "sentence_cache.h"
+#include "candidate_index.h"
 #include "shared.h"
 
-#define MAX_WORDS_PER_SENTENCE 1024
+// initial capacity of the sentence buffers, which grow with longer sentences
+#define WORDS_PER_SENTENCE_HINT 1024
 
 #define DEBUG_EXTR 0
 
@@ -64,6 +68,33 @@ namespace mwer{
 */
 template<class T>
 class CandidateExtractor : public CandidateFilter<T> {
+	public:
+		/**
+		* @brief A table of candidates filled during the corpus pass
+		*
+		* The first table is always the extractor itself. Other tables can be
+		* added with @ref addTable to extract several orders or both surface
+		* and dependency candidates from the same reading of the corpus.
+		*/
+		struct Table {
+			CandidateFilter<T> *filter;
+			int n;
+			bool dependency;
+			int surfMin;
+			int surfMax;
+		};
+
+		/**
+		* @brief An occurrence of a candidate found in a sentence, as stored
+		* in the sentence cache
+		*/
+		struct Occurrence {
+			int table;
+			T *candidate;
+			WordType *prev;
+			WordType *next;
+		};
+
 	private:
 		typedef std::vector<std::vector<Token *> > token_arrays;
 
@@ -77,28 +108,86 @@ class CandidateExtractor : public CandidateFilter<T> {
 		int surfMin;
 		int surfMax;
 		bool extractDependency;
+		std::vector<Table> tables;
 
 		// sentence processing
 		Token nullToken;
 		std::vector<Token *> sentence;
 		std::vector<Tree<Token *>*> trees;
-		void buildDepTree(std::vector<Tree<Token *>* > &trees, Token *token);
-		token_arrays scanDepTree(int n, Tree<Token *> *cur);
-		token_arrays scanSurfTree(int n, Tree<Token *> *cur, int depth);
-		typedef std::function < void (std::vector<WordType *>, std::vector<int>,
+		typedef std::function < void (const std::vector<WordType *> &,
+									  const std::vector<int> &,
 									  int, WordType *, WordType *) > cb_candidate;
+
+		/**
+		* @brief Parameters of one enumeration of the sentence
+		*/
+		struct Extraction {
+			int n;
+			int surfMin;
+			int surfMax;
+			cb_candidate f;
+		};
+
+		// memoized dependency subtrees, indexed by [order][token id]
+		std::vector<std::vector<token_arrays> > depMemo;
+		std::vector<std::vector<bool> > depMemoDone;
+		// widest distance range of the dependency extractions
+		int depMaxSpan;
+
+		// duplicate sentences
+		SentenceCache<Occurrence> *cache;
+		bool recording;
+		std::vector<Occurrence> occurrences;
+		typename SentenceCache<Occurrence>::Key cacheKey;
+		size_t cacheHash;
+		std::chrono::steady_clock::time_point enumerationStart;
+		bool replaySentence();
+		void storeSentence();
+		virtual void replayOccurrence(const Occurrence &o);
+		void clearSentence();
+
+		// enumeration budget
+		double budget;
+		long long nSentences;
+		long long nSkippedSentences;
+		long long nSkippedWords;
+		double countCombinations(int maxOrder, int maxSpan, bool dependency);
+		bool exceedsBudget();
+
+		// if not null, only the groups of tokens that can form one of the
+		// indexed candidates are enumerated
+		const CandidateIndex *guide;
+
+		void buildDepTree(std::vector<Tree<Token *>* > &trees, Token *token);
+		const token_arrays &scanDepTree(int n, Tree<Token *> *cur);
+		void scanSurface(std::vector<Extraction> &extractions,
+						 std::vector<Token *> &prefix, int maxOrder, int maxSpan,
+						 int node);
 		void computeDepCandidates(cb_candidate);
 		void computeSurfCandidates(cb_candidate);
-		void computeCandidate(std::vector<Token *> tokens, bool isId, cb_candidate cb);
+		void computeDepCandidates(std::vector<Extraction> &extractions);
+		void computeSurfCandidates(std::vector<Extraction> &extractions);
+		std::vector<Token *> candidateTokens;
+		std::vector<WordType *> candidateTypes;
+		std::vector<int> candidatePids;
+		void computeCandidate(const std::vector<Token *> &tokens, bool isId,
+							  const Extraction &e);
 		using CandidateFilter<T>::addCandidate;
 		void addCandidate(std::vector<Token *> tokens, bool isId);
-		static token_arrays concat(token_arrays prefix, token_arrays bloc,
-								   unsigned int order);
+		static token_arrays concat(const token_arrays &prefix,
+								   const token_arrays &bloc, unsigned int order,
+								   int maxSpan);
 
 	public:
 		CandidateExtractor(int n, int nFactors, int surfMin, int surfMax,
 						   bool dependency);
 		~CandidateExtractor();
+		void addTable(int n, bool dependency, int surfMin, int surfMax);
+		int getNumberOfTables() const;
+		const Table &getTable(int i) const;
+		void setSentenceCache(int capacity);
+		void setSentenceBudget(double maxCombinations);
+		virtual void printRunStatistics(std::ostream &os);
 		void addToken(std::string s);
 		void computeCandidatesSentence();
 };
@@ -17,9 +17,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
-#include <map>
 #include <algorithm>
 #include <functional>
+#include <sstream>
 
 namespace mwer{
 using namespace std;
@@ -47,11 +47,19 @@ CandidateExtractor<T>::CandidateExtractor(int n, int nFactors,
 	surfMin(surfMin),
 	surfMax(surfMax),
 	extractDependency(dependency),
-	nullToken(nFactors)
+	nullToken(nFactors),
+	cache(0),
+	recording(false),
+	budget(0),
+	nSentences(0),
+	nSkippedSentences(0),
+	nSkippedWords(0),
+	guide(0)
 {
-	this->sentence.reserve(MAX_WORDS_PER_SENTENCE);
+	this->sentence.reserve(WORDS_PER_SENTENCE_HINT);
 	this->sentence.push_back(&nullToken);
-	trees.reserve(MAX_WORDS_PER_SENTENCE);
+	trees.reserve(WORDS_PER_SENTENCE_HINT);
+	tables.push_back({this, n, dependency, surfMin, surfMax});
 }
 
 
@@ -59,6 +67,335 @@ CandidateExtractor<T>::CandidateExtractor(int n, int nFactors,
 template<class T>
 CandidateExtractor<T>::~CandidateExtractor()
 {
+	for (auto it = tables.begin() + 1; it != tables.end(); ++it) {
+		delete it->filter;
+	}
+
+	delete cache;
+}
+
+
+
+/**
+* @brief Enable the cache of duplicate sentences
+*
+* The occurrences of candidates found in the last capacity distinct
+* sentences are kept. When a sentence is read again, its occurrences are
+* replayed instead of enumerating the sentence.
+*
+* @param capacity Number of sentences to keep, 0 to disable the cache
+*/
+template<class T>
+void CandidateExtractor<T>::setSentenceCache(int capacity)
+{
+	delete cache;
+	cache = (capacity > 0) ? new SentenceCache<Occurrence>(capacity) : 0;
+}
+
+
+
+/**
+* @brief Set the maximal number of combinations enumerated in a sentence
+*
+* Sentences are not limited in length, but the number of candidates of a
+* long sentence explodes with a wide distance range. Before enumerating a
+* sentence, the number of groups of tokens to build is counted. If it
+* exceeds the budget, the sentence is skipped and reported.
+*
+* @param maxCombinations Budget per sentence, 0 for no limit
+*/
+template<class T>
+void CandidateExtractor<T>::setSentenceBudget(double maxCombinations)
+{
+	budget = maxCombinations;
+}
+
+
+
+/**
+* @brief Output statistics about the corpus pass
+*
+* @param os stream to output to
+*/
+template<class T>
+void CandidateExtractor<T>::printRunStatistics(ostream &os)
+{
+	if (budget > 0) {
+		os << "Sentences over the enumeration budget : " << nSkippedSentences
+		   << " skipped out of " << nSentences << " (" << nSkippedWords
+		   << " words)" << endl;
+	}
+
+	if (cache != 0) {
+		long long total = cache->getHits() + cache->getMisses();
+		os << "Sentence cache : " << cache->getHits() << " hits out of "
+		   << total << " sentences (";
+		os << ((total == 0) ? 0.0 : 100.0 * cache->getHits() / total);
+		os << "%), " << cache->getSavedTime() << "s of enumeration saved" << endl;
+	}
+}
+
+
+
+/**
+* @brief Replay the current sentence if it is in the cache
+*
+* If it is not, the occurrences found while enumerating the sentence will be
+* recorded until @ref storeSentence is called.
+*
+* @return true if the sentence has been replayed
+*/
+template<class T>
+bool CandidateExtractor<T>::replaySentence()
+{
+	cacheKey.resize(this->sentence.size() - 1);
+
+	for (unsigned int i = 1; i < this->sentence.size(); ++i) {
+		Token *token = this->sentence[i];
+		cacheKey[i - 1] = make_pair(token->getWordType()->getId(),
+									token->getParentId());
+	}
+
+	cacheHash = SentenceCache<Occurrence>::hash(cacheKey);
+	auto entry = cache->find(cacheKey, cacheHash);
+
+	if (entry != 0) {
+		for (auto &o : entry->records) {
+			replayOccurrence(o);
+		}
+
+		return true;
+	}
+
+	recording = true;
+	occurrences.clear();
+	enumerationStart = std::chrono::steady_clock::now();
+	return false;
+}
+
+
+
+/**
+* @brief Store the occurrences recorded since @ref replaySentence
+*/
+template<class T>
+void CandidateExtractor<T>::storeSentence()
+{
+	std::chrono::duration<double> cost =
+		std::chrono::steady_clock::now() - enumerationStart;
+	cache->insert(cacheKey, cacheHash, occurrences, cost.count());
+	recording = false;
+}
+
+
+
+/**
+* @brief Count again an occurrence found in a cached sentence
+*
+* @param o occurrence
+*/
+template<class T>
+void CandidateExtractor<T>::replayOccurrence(const Occurrence &o)
+{
+	o.candidate->updateStatistics();
+}
+
+
+
+/**
+* @brief Count the groups of tokens that the enumeration of the current
+* sentence will build
+*
+* In surface extraction, these are the groups of at most maxOrder tokens
+* spanning at most maxSpan. In dependency extraction, these are the
+* subtrees of at most maxOrder nodes, counted by dynamic programming on the
+* tree.
+*
+* @param maxOrder Maximal size of the groups
+* @param maxSpan Maximal distance between the first and the last token
+* @param dependency Type of extraction
+*
+* @return Number of groups
+*/
+template<class T>
+double CandidateExtractor<T>::countCombinations(int maxOrder, int maxSpan,
+												bool dependency)
+{
+	int size = this->sentence.size();
+	double total = 0;
+
+	if (!dependency) {
+		for (int i = 1; i < size; ++i) {
+			// groups starting with i, completed with tokens on its right
+			double right = std::min((double) size - 1 - i, (double) maxSpan);
+			double c = 1;
+
+			for (int k = 0; k < maxOrder; ++k) {
+				total += c;
+				c = c * (right - k) / (k + 1);
+			}
+		}
+
+		return total;
+	}
+
+	vector<vector<int> > children(size);
+
+	for (int i = 1; i < size; ++i) {
+		int parent = this->sentence[i]->getParentId();
+
+		if (parent >= 0 && parent < size) {
+			children[parent].push_back(i);
+		}
+	}
+
+	// nodes sorted so that children come before their parents
+	vector<int> order(1, 0);
+
+	for (unsigned int i = 0; i < order.size(); ++i) {
+		order.insert(order.end(), children[order[i]].begin(),
+					 children[order[i]].end());
+	}
+
+	// count[v][k] : number of subtrees of k nodes whose top node is v
+	vector<vector<double> > count(size, vector<double>(maxOrder + 1, 0));
+
+	for (auto v = order.rbegin(); v != order.rend(); ++v) {
+		vector<double> &c = count[*v];
+		c[1] = 1;
+
+		for (int child : children[*v]) {
+			for (int a = maxOrder - 1; a >= 1; --a) {
+				for (int b = 1; a + b <= maxOrder; ++b) {
+					c[a + b] += c[a] * count[child][b];
+				}
+			}
+		}
+
+		if (*v != 0) {
+			for (int k = 1; k <= maxOrder; ++k) {
+				total += c[k];
+			}
+		}
+	}
+
+	return total;
+}
+
+
+
+/**
+* @brief Check the current sentence against the enumeration budget
+*
+* A sentence over the budget is counted and reported on the error output.
+*
+* @return true if the sentence must be skipped
+*/
+template<class T>
+bool CandidateExtractor<T>::exceedsBudget()
+{
+	++nSentences;
+
+	if (budget <= 0) {
+		return false;
+	}
+
+	double combinations = 0;
+
+	for (bool dependency : {true, false}) {
+		int maxOrder = 0;
+		int maxSpan = 0;
+
+		for (auto &t : tables) {
+			if (t.dependency == dependency) {
+				maxOrder = std::max(maxOrder, t.n);
+				maxSpan = std::max(maxSpan, t.surfMax);
+			}
+		}
+
+		if (maxOrder > 0) {
+			combinations += countCombinations(maxOrder, maxSpan, dependency);
+		}
+	}
+
+	if (combinations <= budget) {
+		return false;
+	}
+
+	++nSkippedSentences;
+	nSkippedWords += this->sentence.size() - 1;
+	// one write, as the sentences can be counted by several threads
+	std::ostringstream warning;
+	warning << "Warning: sentence " << nSentences << " (" << this->sentence.size() - 1
+			<< " words) skipped : " << combinations
+			<< " combinations exceed the budget" << endl;
+	cerr << warning.str();
+	return true;
+}
+
+
+
+/**
+* @brief Delete the tokens of the current sentence
+*/
+template<class T>
+void CandidateExtractor<T>::clearSentence()
+{
+	for (auto it = this->sentence.begin() + 1;
+			it != this->sentence.end(); ++it) {
+		delete *it;
+	}
+
+	this->sentence.clear();
+	this->sentence.push_back(&nullToken);
+}
+
+
+
+/**
+* @brief Add a table of candidates to fill during the same corpus pass
+*
+* Each sentence is tokenized once, and every table is filled from the same
+* enumeration of the sentence : dependency subtrees are shared between
+* orders, and surface candidates of every order are built from the same
+* window walk.
+*
+* @param n Number of word types contained in the MWE candidates of the table
+* @param dependency If true, dependency candidates, else surface candidates
+* @param surfMin Minimal distance of the two furthest tokens in a candidate
+* @param surfMax Maximal distance of the two furthest tokens in a candidate
+*/
+template<class T>
+void CandidateExtractor<T>::addTable(int n, bool dependency,
+									 int surfMin, int surfMax)
+{
+	if ((int) permutations.size() < n + 1) {
+		permutations.resize(n + 1);
+	}
+
+	tables.push_back({new CandidateFilter<T>(n), n, dependency, surfMin, surfMax});
+}
+
+
+
+template<class T>
+int CandidateExtractor<T>::getNumberOfTables() const
+{
+	return tables.size();
+}
+
+
+
+/**
+* @param i Index of the table, 0 being the extractor itself
+*
+* @return the i-th table of candidates
+*/
+template<class T>
+const typename CandidateExtractor<T>::Table &
+CandidateExtractor<T>::getTable(int i) const
+{
+	return tables[i];
 }
 
 
@@ -115,9 +452,34 @@ void CandidateExtractor<T>::addToken(string tokenStr)
 */
 template<class T>
 void CandidateExtractor<T>::computeDepCandidates(cb_candidate f)
+{
+	vector<Extraction> extractions = {{CandidateFilter<T>::n, surfMin, surfMax, f}};
+	computeDepCandidates(extractions);
+}
+
+
+
+/**
+* @brief Compute dependency candidates for several extractions at once
+*
+* The tree is built once, and the subtrees found while scanning it are
+* memoized, so that the subtrees of smaller orders are shared between the
+* extractions (and between the nodes of the tree).
+*
+* @param extractions Orders, distance ranges and callbacks
+*/
+template<class T>
+void CandidateExtractor<T>::computeDepCandidates(vector<Extraction> &extractions)
 {
 	int size = this->sentence.size();
-	token_arrays c;
+	int maxOrder = 0;
+	depMaxSpan = 0;
+
+	for (auto &e : extractions) {
+		maxOrder = std::max(maxOrder, e.n);
+		depMaxSpan = std::max(depMaxSpan, e.surfMax);
+	}
+
 	// Initialising the root
 	Tree<Token *> *root = new Tree<Token *>(&nullToken);
 	trees.resize(size, 0);
@@ -129,16 +491,24 @@ void CandidateExtractor<T>::computeDepCandidates(cb_candidate f)
 		}
 	}
 
-	for (auto it = trees.begin() + 1; it != trees.end(); ++it) {
-		c = scanDepTree(CandidateFilter<T>::n, *it);
+	depMemo.assign(maxOrder + 1, vector<token_arrays>(size));
+	depMemoDone.assign(maxOrder + 1, vector<bool>(size, false));
+
+	for (auto &e : extractions) {
+		for (auto it = trees.begin() + 1; it != trees.end(); ++it) {
+			const token_arrays &c = scanDepTree(e.n, *it);
 
-		for (auto it = c.begin(); it != c.end(); ++it) {
-			if ((int) it->size() == CandidateFilter<T>::n) {
-				this->computeCandidate(*it, true, f);
+			for (auto it = c.begin(); it != c.end(); ++it) {
+				if ((int) it->size() == e.n) {
+					this->computeCandidate(*it, true, e);
+				}
 			}
 		}
 	}
 
+	depMemo.clear();
+	depMemoDone.clear();
+
 	// clear the tree
 	for (auto it = trees.begin(); it != trees.end(); ++it) {
 		delete *it;
@@ -152,42 +522,58 @@ void CandidateExtractor<T>::computeDepCandidates(cb_candidate f)
 /**
 * @brief Compute surface candidates
 *
-* First, it builds a chain (graph theory) where nodes are tokens.
-* Then it scans the tree and add every candidate that have a right distance.
+* Every group of tokens of the sentence is built by extending a prefix with
+* tokens on its right, as long as the distance allows it.
 *
 * @param f Callback function to be executed on every candidate
 */
 template <class T>
 void CandidateExtractor<T>::computeSurfCandidates(cb_candidate f)
 {
-	int size = this->sentence.size();
-	token_arrays c;
-	Tree<Token *> *root = new Tree<Token *>(&nullToken);
-	trees.resize(size, 0);
-	trees[0] = root;
+	vector<Extraction> extractions = {{CandidateFilter<T>::n, surfMin, surfMax, f}};
+	computeSurfCandidates(extractions);
+}
 
-	// Build a chain to compute candidates using the same
-	// algorithm as for dependency bigrams
-	// a chain is also a tree, so the algorithm works fine
 
-	for (int i = 1; i < size; i++) {
-		trees[i] = new Tree<Token *>(this->sentence[i]);
-		trees[i]->linkWithFather(trees[i - 1]);
-	}
 
-	// root has only one child here
-	c = scanSurfTree(CandidateFilter<T>::n, *root->childrenBegin(), 0);
+/**
+* @brief Compute surface candidates for several extractions at once
+*
+* The prefixes are shared : a group of m tokens is built once, passed to the
+* extractions of order m, then extended for the extractions of higher orders.
+*
+* @param extractions Orders, distance ranges and callbacks
+*/
+template <class T>
+void CandidateExtractor<T>::computeSurfCandidates(vector<Extraction> &extractions)
+{
+	int size = this->sentence.size();
+	int maxOrder = 0;
+	int maxSpan = 0;
 
-	for (auto it = c.begin(); it != c.end(); ++it) {
-		this->computeCandidate(*it, false, f);
+	for (auto &e : extractions) {
+		maxOrder = std::max(maxOrder, e.n);
+		maxSpan = std::max(maxSpan, e.surfMax);
 	}
 
-	// clear the tree
-	for (auto it = trees.begin(); it != trees.end(); ++it) {
-		delete *it;
-	}
+	vector<Token *> prefix;
+	prefix.reserve(maxOrder);
 
-	trees.clear();
+	for (int i = 1; i < size; ++i) {
+		int node = 0;
+
+		if (guide != 0) {
+			node = guide->child(0, this->sentence[i]->getWordType()->getId());
+
+			if (node < 0) {
+				continue;
+			}
+		}
+
+		prefix.push_back(this->sentence[i]);
+		scanSurface(extractions, prefix, maxOrder, maxSpan, node);
+		prefix.pop_back();
+	}
 }
 
 
@@ -196,30 +582,53 @@ void CandidateExtractor<T>::computeSurfCandidates(cb_candidate f)
 * @brief This function must be called once that all the tokens of a sentence
 * have been added with addToken. All the entered tokens will be used to
 * compute all the candidates according to the parameters entered in the
-* constructor.
+* constructor, and in the tables added with addTable.
 */
 template<class T>
 void CandidateExtractor<T>::computeCandidatesSentence()
 {
-	cb_candidate f = std::bind(
-						 &CandidateFilter<T>::addCandidate,
-						 this, _1, _2, _3);
+	if (exceedsBudget() || (cache != 0 && replaySentence())) {
+		clearSentence();
+		return;
+	}
+
+	vector<Extraction> dependencyExtractions;
+	vector<Extraction> surfaceExtractions;
+
+	for (int i = 0; i < (int) tables.size(); ++i) {
+		const Table &t = tables[i];
+		CandidateFilter<T> *filter = t.filter;
+		cb_candidate f = [this, i, filter] (const vector<WordType *> &types,
+											const vector<int> &pids, int freq,
+											WordType *prev, WordType *next) {
+			T *c = filter->addCandidate(types, pids, freq);
 
-	if (extractDependency) {
-		computeDepCandidates(f);
-	} else if ((int) this->sentence.size() > CandidateFilter<T>::n) {
-		// sentence must be long enough to process surface candidates
-		computeSurfCandidates(f);
+			if (recording) {
+				occurrences.push_back({i, c, prev, next});
+			}
+		};
+		Extraction e = {t.n, t.surfMin, t.surfMax, f};
+
+		if (t.dependency) {
+			dependencyExtractions.push_back(e);
+		} else {
+			surfaceExtractions.push_back(e);
+		}
 	}
 
-	// clear the sentences informations
-	for (auto it = this->sentence.begin() + 1;
-			it != this->sentence.end(); ++it) {
-		delete *it;
+	if (!dependencyExtractions.empty()) {
+		computeDepCandidates(dependencyExtractions);
 	}
 
-	this->sentence.clear();
-	this->sentence.push_back(&nullToken);
+	if (!surfaceExtractions.empty()) {
+		computeSurfCandidates(surfaceExtractions);
+	}
+
+	if (recording) {
+		storeSentence();
+	}
+
+	clearSentence();
 }
 
 
@@ -269,21 +678,24 @@ vector<vector<int> > CandidateExtractor<T>::getPermutations(int n, int m)
 
 
 /**
- * @brief Apply f on the candidate if the distance is correct
- * (using surfMin, surfMax) 
+ * @brief Apply the callback of e on the candidate if the distance is correct
+ * (using e.surfMin, e.surfMax)
  *
  * @param tokens Candidate in the form of tokens
  * @param isId if True, it means that tokens are not sorted by id
- * @param f Callback function to apply
+ * @param e Extraction whose callback to apply
  */
 template<class T>
-void CandidateExtractor<T>::computeCandidate(vector<Token *> tokens,
+void CandidateExtractor<T>::computeCandidate(const vector<Token *> &unsorted,
 											 bool isId,
-											 cb_candidate f)
+											 const Extraction &e)
 {
-	vector<WordType *> types(tokens.size());
-	vector<int> pids;
-	map<int, int> mappingIds;
+	// the buffers are members so that no allocation occurs once they are
+	// large enough
+	vector<Token *> &tokens = candidateTokens;
+	vector<WordType *> &types = candidateTypes;
+	vector<int> &pids = candidatePids;
+	tokens.assign(unsorted.begin(), unsorted.end());
 
 	if (isId) {
 		std::sort(tokens.begin(), tokens.end(), Token::idIsInferior);
@@ -291,28 +703,34 @@ void CandidateExtractor<T>::computeCandidate(vector<Token *> tokens,
 
 	int maxDistance = (tokens.back())->getId() - (tokens.front())->getId();
 
-	if (maxDistance > surfMax || maxDistance < surfMin) {
+	if (maxDistance > e.surfMax || maxDistance < e.surfMin) {
 		return;
 	}
 
-	mappingIds[0] = 0;
-	int counter = 0;
+	types.resize(tokens.size());
 
-	for (auto it = tokens.begin(); it != tokens.end(); ++it) {
-		mappingIds[(*it)->getId()] = counter + 1;
-		types[counter] = (*it)->getWordType();
-		TRACE("map[" << (*it)->getId() << "] = " << counter + 1);
-		++counter;
+	for (unsigned int i = 0; i < tokens.size(); ++i) {
+		types[i] = tokens[i]->getWordType();
 	}
 
+	pids.clear();
+
 	if (isId) {
-		pids.resize(tokens.size());
-		counter = 0;
+		// parent ids are mapped to positions in the candidate (from 1), or 0
+		// if the parent is not in the candidate
+		for (unsigned int i = 0; i < tokens.size(); ++i) {
+			int parentId = tokens[i]->getParentId();
+			int position = 0;
+
+			for (unsigned int j = 0; j < tokens.size() && parentId != 0; ++j) {
+				if (tokens[j]->getId() == parentId) {
+					position = j + 1;
+					break;
+				}
+			}
 
-		for (auto it = tokens.begin(); it != tokens.end(); ++it) {
-			pids[counter] = mappingIds[(*it)->getParentId()];
-			TRACE("pids[" << counter << "] = " << pids[counter]);
-			++counter;
+			pids.push_back(position);
+			TRACE("pids[" << i << "] = " << position);
 		}
 	}
 
@@ -332,7 +750,7 @@ void CandidateExtractor<T>::computeCandidate(vector<Token *> tokens,
 		typeNext = sentence[idLast + 1]->getWordType();
 	}
 
-	f(types, pids, 1, typePrev, typeNext);
+	e.f(types, pids, 1, typePrev, typeNext);
 }
 
 
@@ -340,6 +758,13 @@ void CandidateExtractor<T>::computeCandidate(vector<Token *> tokens,
 /**
  * @brief Extract a token_arrays of all possible candidates in a dependency tree
  *
+ * The results are memoized for the current sentence : a subtree of a given
+ * order is scanned only once, whatever the number of times it is needed by
+ * its ancestors or by the extractions of higher orders.
+ *
+ * Subtrees whose tokens span more than depMaxSpan are dropped as soon as
+ * they are built : adding tokens can only widen the span.
+ *
  * @param order Number of types in a candidate : should be n
  * This parameter exists because it is a recursive function.
  * @param t root of the tree of tokens
@@ -347,29 +772,40 @@ void CandidateExtractor<T>::computeCandidate(vector<Token *> tokens,
  * @return token_arrays of all possible candidates
  */
 template<class T>
-typename CandidateExtractor<T>::token_arrays
+const typename CandidateExtractor<T>::token_arrays &
 CandidateExtractor<T>::scanDepTree(
 	int order, Tree<Token *> *t)
 {
-	int nChildren = t->numberOfChildren();
 	Token *token = t->getElement();
+	int id = token->getId();
+	token_arrays &totalPermutations = depMemo[order][id];
+
+	if (depMemoDone[order][id]) {
+		return totalPermutations;
+	}
+
+	depMemoDone[order][id] = true;
+	int nChildren = t->numberOfChildren();
+	int typeId = token->getWordType()->getId();
+
+	if (guide != 0 && !guide->hasType(typeId)) {
+		// no candidate contains this token
+		return totalPermutations;
+	}
 
 	// case 1 : leaf
 	if (nChildren == 0) {
 		// if we needed only 1 type, we add it
 		// we therefore output only 1 candidate
 		if (order == 1) {
-			token_arrays c2(1);
-			c2[0].push_back(token);
-			return c2;
+			totalPermutations.push_back({token});
 		}
 
 		// if there was more types needed, we can't provide enough so we stop
-		return token_arrays();
+		return totalPermutations;
 	}
 
 	// case 2 : has children : recurse
-	token_arrays totalPermutations;
 	// compute all permutations that includes the current node
 	// we are therefore looking for (order - 1) types among the children
 	// in every possible ways
@@ -386,11 +822,19 @@ CandidateExtractor<T>::scanDepTree(
 		int permutationLength = 1;
 
 		// we will now generate all the token_arrays containing this singleton
-		for (auto child = t->childrenBegin(); child != t->childrenEnd(); ++child) {
+		for (auto child = t->childrenBegin();
+				child != t->childrenEnd() && !temp.empty(); ++child) {
 			if (combi[i][j] != 0) {
-				auto res = scanDepTree(combi[i][j], *child);
+				if (guide != 0 &&
+						!guide->hasEdge(typeId, (*child)->getElement()->getWordType()->getId())) {
+					// no candidate contains this dependency
+					temp.clear();
+					break;
+				}
+
+				const token_arrays &res = scanDepTree(combi[i][j], *child);
 				permutationLength += combi[i][j];
-				temp = concat(temp, res, permutationLength);
+				temp = concat(temp, res, permutationLength, depMaxSpan);
 			}
 
 			j++;
@@ -405,84 +849,77 @@ CandidateExtractor<T>::scanDepTree(
 
 
 /**
- * @brief Extract a token_arrays of all possible candidates in a surface tree (chain)
+ * @brief Extend a prefix of surface candidate with the tokens on its right
  *
- * @param order Number of types in a candidate : should be n
- * This parameter exists because it is a recursive function.
- * @param t root of the tree of tokens
- * @param depth Should be 0 in the beginning of the recursion
+ * The prefix is passed to every extraction of its size before being
+ * extended. The prefix is never extended beyond maxSpan tokens from its
+ * first token. With a guide, it is only extended along the trie of the
+ * candidates.
  *
- * @return token_arrays of all possible candidates
+ * @param extractions Orders, distance ranges and callbacks
+ * @param prefix Tokens already chosen, sorted by id
+ * @param maxOrder Maximal size of the prefix
+ * @param maxSpan Maximal distance between the first and the last token
+ * @param node Node of the guide's trie matching the prefix
  */
-
 template<class T>
-typename CandidateExtractor<T>::token_arrays
-CandidateExtractor<T>::scanSurfTree(
-	int order, Tree<Token *> *t, int depth)
+void CandidateExtractor<T>::scanSurface(vector<Extraction> &extractions,
+										vector<Token *> &prefix,
+										int maxOrder, int maxSpan, int node)
 {
-	Token *token = t->getElement();
+	int order = prefix.size();
 
-	// case 1 : leaf or surfMax reached
-	if (order < 1 || t->numberOfChildren() == 0 || depth == surfMax) {
-		// if we needed only 1 type, we add it
-		// we therefore output only 1 candidate
-		if (order == 1 && surfMin <= depth) {
-			token_arrays c2(1);
-			c2[0].push_back(token);
-			return c2;
+	for (auto &e : extractions) {
+		if (e.n == order) {
+			this->computeCandidate(prefix, false, e);
 		}
+	}
 
-		// if there was more types needed, we can't provide enough so we stop
-		return token_arrays();
+	if (order == maxOrder) {
+		return;
 	}
 
-	Tree<Token *> *child = *(t->childrenBegin());
-	// case 2 : has children and distance max not reached
-	token_arrays totalPermutations;
-	// compute all possibilities without the current node
-	token_arrays childRes;
+	int size = this->sentence.size();
+	int first = prefix.front()->getId();
 
-	if (depth == 0) {
-		childRes = scanSurfTree(order, child, 0);
-	} else {
-		childRes = scanSurfTree(order, child, depth + 1);
-	}
+	for (int i = prefix.back()->getId() + 1;
+			i < size && i - first <= maxSpan; ++i) {
+		int next = 0;
 
-	totalPermutations.insert(totalPermutations.end(), childRes.begin(),
-							 childRes.end());
-	// compute all possibilities with the current node
-	token_arrays temp(1);
-	temp[0].push_back(token);
-	childRes = scanSurfTree(order - 1, child, depth + 1);
-	temp = concat(temp, childRes, order);
-	totalPermutations.insert(totalPermutations.end(), temp.begin(), temp.end());
-	return totalPermutations;
-}
+		if (guide != 0) {
+			next = guide->child(node, this->sentence[i]->getWordType()->getId());
+
+			if (next < 0) {
+				continue;
+			}
+		}
 
+		prefix.push_back(this->sentence[i]);
+		scanSurface(extractions, prefix, maxOrder, maxSpan, next);
+		prefix.pop_back();
+	}
+}
 
 
 
 /**
  * @brief Tool-function to concatenate 2 arrays in a specific way
  *
- * Prefix will be append to block and only lines of size order will be kept
+ * Prefix will be append to block and only lines of size order will be kept,
+ * if the ids of their tokens do not span more than maxSpan
  *
  * @param prefix prefix to append to block
  * @param block  
  * @param order line size
+ * @param maxSpan maximal distance between the first and the last token
  *
- * @return concatenated array
+ * @return concatenated array, empty if one of the arrays is empty
  */
 template<class T>
 typename CandidateExtractor<T>::token_arrays CandidateExtractor<T>::concat(
-	token_arrays prefix, token_arrays block, unsigned int order)
+	const token_arrays &prefix, const token_arrays &block, unsigned int order,
+	int maxSpan)
 {
-	if (prefix.size() == 0) {
-		return block;
-	} else if (block.size() == 0) {
-		return prefix;
-	}
-
 	token_arrays res;
 
 	for (auto it1 = prefix.begin(); it1 != prefix.end(); ++it1) {
@@ -490,7 +927,12 @@ typename CandidateExtractor<T>::token_arrays CandidateExtractor<T>::concat(
 			if (order == it1->size() + it2->size()) {
 				vector<Token *> temp = *it1;
 				temp.insert(temp.end(), it2->begin(), it2->end());
-				res.push_back(temp);
+				auto bounds = std::minmax_element(temp.begin(), temp.end(),
+												  Token::idIsInferior);
+
+				if ((*bounds.second)->getId() - (*bounds.first)->getId() <= maxSpan) {
+					res.push_back(temp);
+				}
 			}
 		}
 	}
@@ -500,7 +942,6 @@ typename CandidateExtractor<T>::token_arrays CandidateExtractor<T>::concat(
 
 
 
-
 /**
  * @brief Build a dependency tree according to tokens' ids and parent ids
  *
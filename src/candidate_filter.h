@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <string>
 #include <unordered_set>
 #include <set>
+#include <vector>
 #include <utility>
 #include <iostream>
 #include <fstream>
@@ -54,8 +55,10 @@ class CandidateFilter {
 		// word types and candidates storage
 		std::unordered_set<T *, CandidateHash, CandidateEq> candidates;
 		std::unordered_set<WordType *, WordTypeHash, WordTypeEq> wordTypes;
+		std::vector<WordType *> typesById;
 
 		virtual void outputData(std::unique_ptr<std::ostream>);
+		virtual void initWordType(WordType *type);
 
 	public:
 		typedef std::set<T *, CandidateLexCompare> orderedSet;
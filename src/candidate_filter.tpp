@@ -88,6 +88,10 @@ WordType *CandidateFilter<T>::addWordType(string formOrLemma,
 
 	if (!res.second) { // WordType already exists
 		delete type;
+	} else {
+		type->setId(typesById.size());
+		typesById.push_back(type);
+		initWordType(type);
 	}
 
 	return *res.first;
@@ -214,6 +218,18 @@ void CandidateFilter<T>::outputData(unique_ptr<ostream> stream)
 
 
 
+/**
+ * @brief Called once for every new type, when it is interned
+ *
+ * @param type new type
+ */
+template<class T>
+void CandidateFilter<T>::initWordType(WordType *type)
+{
+}
+
+
+
 template<class T>
 CandidateFilter<T>::~CandidateFilter()
 {
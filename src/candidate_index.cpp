@@ -0,0 +1,97 @@
+/*
+mwer : multi-word expressions extractor
+Copyright (C) 2013  Tom Bosc
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "candidate_index.h"
+
+namespace mwer{
+CandidateIndex::CandidateIndex() :
+	nNodes(1)
+{
+}
+
+
+
+uint64_t CandidateIndex::pair(int a, int b)
+{
+	return ((uint64_t)(uint32_t) a << 32) | (uint32_t) b;
+}
+
+
+
+/**
+* @brief Index a candidate
+*
+* @param v types of the candidate, which must be interned
+* @param pids parent ids (positions in the candidate, from 1), or empty
+*/
+void CandidateIndex::insert(const std::vector<WordType *> &v,
+							const std::vector<int> &pids)
+{
+	int node = 0;
+
+	for (unsigned int i = 0; i < v.size(); ++i) {
+		int id = v[i]->getId();
+
+		if (id >= (int) types.size()) {
+			types.resize(id + 1, false);
+		}
+
+		types[id] = true;
+		auto res = trie.insert(std::make_pair(pair(node, id), nNodes));
+
+		if (res.second) {
+			++nNodes;
+		}
+
+		node = res.first->second;
+
+		if (i < pids.size() && pids[i] > 0) {
+			edges.insert(pair(v[pids[i] - 1]->getId(), id));
+		}
+	}
+}
+
+
+
+bool CandidateIndex::hasType(int id) const
+{
+	return id < (int) types.size() && types[id];
+}
+
+
+
+bool CandidateIndex::hasEdge(int parentType, int childType) const
+{
+	return edges.count(pair(parentType, childType)) != 0;
+}
+
+
+
+/**
+* @param node node of the trie
+* @param type type id
+*
+* @return child of node along type, or -1
+*/
+int CandidateIndex::child(int node, int type) const
+{
+	auto it = trie.find(pair(node, type));
+	return (it == trie.end()) ? -1 : it->second;
+}
+}
@@ -0,0 +1,62 @@
+/*
+mwer : multi-word expressions extractor
+Copyright (C) 2013  Tom Bosc
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef CANDIDATE_INDEX_H_
+#define CANDIDATE_INDEX_H_
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+
+#include "word_type.h"
+
+namespace mwer{
+/**
+* @brief An index of a fixed list of candidates, guiding their search in a
+* sentence
+*
+* It records the types appearing in the candidates, a trie of the sequences
+* of types (for surface candidates) and the (parent type, child type)
+* dependencies (for dependency candidates). A group of tokens which is not
+* a path of the trie, or which contains a type or a dependency that is not
+* recorded, can't be completed into a candidate.
+*/
+class CandidateIndex {
+	private:
+		std::vector<bool> types; // indexed by type id
+		std::unordered_set<uint64_t> edges;
+		// trie : (node, type id) -> child node. The root is 0.
+		std::unordered_map<uint64_t, int> trie;
+		int nNodes;
+
+		static uint64_t pair(int a, int b);
+
+	public:
+		CandidateIndex();
+
+		void insert(const std::vector<WordType *> &v, const std::vector<int> &pids);
+
+		bool hasType(int id) const;
+		bool hasEdge(int parentType, int childType) const;
+		int child(int node, int type) const;
+};
+}
+
+#endif
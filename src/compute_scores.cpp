@@ -24,6 +24,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <fstream>
 #include <utility>
 #include <memory>
+#include <thread>
+#include <queue>
+#include <cmath>
 
 #include "score_calculator.h"
 #include "parser.h"
@@ -32,6 +35,32 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 using namespace mwer;
 using namespace std;
 
+#define CANDIDATES_PER_BATCH 4096
+
+typedef vector<string>::const_iterator line_iterator;
+
+/**
+* @brief Line of scores kept for the top-k selection
+*
+* Lines are ordered by decreasing key, then in the order of the input. NaN
+* keys come last.
+*/
+struct RankedLine {
+	float key;
+	long long index;
+	string line;
+
+	bool operator<(const RankedLine &other) const
+	{
+		if (std::isnan(key) || std::isnan(other.key)) {
+			return !std::isnan(key) ||
+				   (std::isnan(other.key) && index < other.index);
+		}
+
+		return key > other.key || (key == other.key && index < other.index);
+	}
+};
+
 pair<vector<string>, vector<int> > parseContext(vector<string> v)
 {
 	vector<string> resName;
@@ -51,13 +80,185 @@ pair<vector<string>, vector<int> > parseContext(vector<string> v)
 }
 
 
+
+/**
+* @brief Append the scores of a candidate to the output
+*
+* @param types first section of the candidate line
+* @param scores computed scores
+* @param out output
+*/
+void appendScores(const string &types, const vector<float> &scores, string &out)
+{
+	out += types;
+	out += SEP_SECTIONS;
+
+	for (auto s = scores.begin(); s != scores.end() - 1; ++s) {
+		out += std::to_string(*s);
+		out += SEP_WORDS;
+	}
+
+	out += std::to_string(scores.back());
+	out += '\n';
+}
+
+
+
+/**
+* @brief Score a range of candidate lines of the statistics file
+*
+* When no score needs contexts, the candidates are scored by batch and only
+* the contingency tables are parsed.
+*
+* @param sc calculator used for these candidates
+* @param begin first line
+* @param end end of the range
+* @param immediateContext true if lines contain the immediate contexts
+* @param broadContext true if lines contain the broad context
+* @param out output, where lines of scores are appended
+* @param keys if not null, score used by the top-k selection of each line
+* appended to out
+* @param keyIndex index of that score among the computed scores
+* @param ranker if not null, calculator of that score only : in batch mode,
+* the candidates whose score is not greater than threshold are not fully
+* scored nor appended
+* @param threshold key of the worst candidate kept by the top-k selection
+*/
+void scoreCandidates(ScoreCalculator &sc, line_iterator begin,
+					 line_iterator end, bool immediateContext,
+					 bool broadContext, string &out,
+					 vector<float> *keys = 0, int keyIndex = 0,
+					 ScoreCalculator *ranker = 0, float threshold = 0)
+{
+	std::vector<int> contingencyTable;
+	auto parseTable = [&] (const string &s) {
+		vector<string> section = split(s, SEP_WORDS);
+		contingencyTable.resize(section.size()); // 2^n values
+		std::transform(section.begin(), section.end(),
+					   contingencyTable.begin(),
+		[] (std::string & s) {
+			return stoi(s);
+		});
+	};
+
+	if (sc.canComputeBatch()) {
+		ScoreCalculator::TableBatch batch;
+
+		for (auto line = begin; line != end; ++line) {
+			size_t endOfTypes = line->find(SEP_SECTIONS);
+			size_t endOfTable = line->find(SEP_SECTIONS, endOfTypes + 1);
+			parseTable(line->substr(endOfTypes + 1, endOfTable - endOfTypes - 1));
+			batch.add(contingencyTable);
+		}
+
+		// selected[i] : line of the i-th candidate to score
+		vector<int> selected;
+
+		if (ranker != 0) {
+			// Only the score of the selection is computed for every candidate
+			vector<float> rank = ranker->computeBatch(batch)[0];
+			ScoreCalculator::TableBatch promising;
+
+			for (int i = 0; i < batch.size(); ++i) {
+				if (rank[i] > threshold) {
+					selected.push_back(i);
+					promising.a.push_back(batch.a[i]);
+					promising.b.push_back(batch.b[i]);
+					promising.c.push_back(batch.c[i]);
+					promising.d.push_back(batch.d[i]);
+				}
+			}
+
+			batch = promising;
+		} else {
+			for (int i = 0; i < batch.size(); ++i) {
+				selected.push_back(i);
+			}
+		}
+
+		auto scores = sc.computeBatch(batch);
+		vector<float> candidateScores(scores.size());
+
+		for (int i = 0; i < batch.size(); ++i) {
+			for (int s = 0; s < (int) scores.size(); ++s) {
+				candidateScores[s] = scores[s][i];
+			}
+
+			const string &line = *(begin + selected[i]);
+			appendScores(line.substr(0, line.find(SEP_SECTIONS)),
+						 candidateScores, out);
+
+			if (keys != 0) {
+				keys->push_back(candidateScores[keyIndex]);
+			}
+		}
+
+		return;
+	}
+
+	for (auto line = begin; line != end; ++line) {
+		vector<string> sections = split(*line, SEP_SECTIONS);
+
+		if (broadContext) {
+			// We strip the candidate to keep only comparable factors :
+			// form & lemma
+			vector<string> strippedTypes = split(sections[0], SEP_WORDS);
+			for (string & t : strippedTypes) {
+				size_t first_sep, second_sep;
+				first_sep = t.find(SEP_FACTORS, 0);
+
+				if (first_sep != string::npos) {
+					second_sep = t.find(SEP_FACTORS, first_sep + 1);
+
+					if (second_sep != string::npos) {
+						t.erase(t.begin() + second_sep, t.end());
+					}
+				}
+			}
+
+			sc.newCandidate(strippedTypes);
+		} else {
+			sc.newCandidate();
+		}
+
+		parseTable(sections[1]);
+		sc.addContingencyTable(contingencyTable);
+
+		if (immediateContext) {
+			auto context = parseContext(split(sections[2], SEP_WORDS));
+			sc.addToImmediateContext(ScoreCalculator::LEFT,
+									 context.first, context.second);
+			context = parseContext(split(sections[3], SEP_WORDS));
+			sc.addToImmediateContext(ScoreCalculator::RIGHT,
+									 context.first, context.second);
+		}
+
+		if (broadContext) {
+			auto context = parseContext(split(sections[4], SEP_WORDS));
+			sc.addToBroadContext(context.first, context.second);
+		}
+
+		vector<float> scores = sc.compute();
+		appendScores(sections[0], scores, out);
+
+		if (keys != 0) {
+			keys->push_back(scores[keyIndex]);
+		}
+	}
+}
+
+
 int main(int argc, char *argv[])
 {
 	bool compressedOutput;
 	string statisticsFile;
 	string output;
+	string unigramsFile;
 	opterr = 0;
 	float smoothingParam = 0.5;
+	int threads = 1;
+	int topK = 0;
+	int topKScore = -1;
 	static struct option long_options[] = {
 		// flags
 		{"help",  no_argument, 0, 'h'},
@@ -65,6 +266,10 @@ int main(int argc, char *argv[])
 		{"input", required_argument, 0, 'i'},
 		{"output", required_argument, 0, 'o'},
 		{"smoothing", optional_argument, 0, 's'},
+		{"threads", required_argument, 0, 'T'},
+		{"top-k", required_argument, 0, 'K'},
+		{"by", required_argument, 0, 'B'},
+		{"unigrams", required_argument, 0, 'U'},
 		{0, 0, 0, 0}
 	};
 	int option_index;
@@ -80,13 +285,19 @@ int main(int argc, char *argv[])
 			case 'h':
 				cout << "compute_scores : Computes scores" << endl;
 				cout << "compute_scores s1 [s2 ... sn] -i input_stat -o output_scores " << endl;
-				cout << "[-s smoothing_parameter]" << endl;
+				cout << "[-s smoothing_parameter] [--threads n] [--top-k k --by s]" << endl;
+				cout << "[--unigrams types_file]" << endl;
 				cout << "Mandatory : " << endl;
 				cout << "  s1 [s2 ... sn] : scores to compute" << endl;
 				cout << "  -i : input stat file" << endl;
 				cout << "  -o : output score file" << endl;
 				cout << "Optional : " << endl;
 				cout << "  -s : smoothing parameter (default=" << smoothingParam << ")" << endl;
+				cout << "  --threads n : number of threads computing the scores" << endl;
+				cout << "  --top-k k --by s : only output the k best candidates by" <<
+					 " score s, sorted" << endl;
+				cout << "  --unigrams f : binary file of the one type candidates," <<
+					 " written unless it was saved from the input stat file" << endl;
 
 				return 0;
 
@@ -98,6 +309,22 @@ int main(int argc, char *argv[])
 				smoothingParam = std::stof(optarg);
 				break;
 
+			case 'T':
+				threads = atoi(optarg);
+				break;
+
+			case 'K':
+				topK = atoi(optarg);
+				break;
+
+			case 'B':
+				topKScore = atoi(optarg);
+				break;
+
+			case 'U':
+				unigramsFile = optarg;
+				break;
+
 			case '?':
 				cout << "Error: unrecognized option -" << (char) optopt <<
 					 " OR missing argument" << endl;
@@ -130,6 +357,27 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
+	if (threads < 1) {
+		cerr << "Error: the number of threads must be at least 1" << endl;
+		return 1;
+	}
+
+	// position of the score of the top-k selection among the computed scores
+	int keyIndex = find(toCompute.begin(), toCompute.end(), topKScore) -
+				   toCompute.begin();
+
+	if (topK != 0 || topKScore != -1) {
+		if (topK < 1) {
+			cerr << "Error: --top-k must be at least 1" << endl;
+			return 1;
+		}
+
+		if (keyIndex == (int) toCompute.size()) {
+			cerr << "Error: --by must be one of the scores to compute" << endl;
+			return 1;
+		}
+	}
+
 	cout << "Reading statistics file " << statisticsFile << endl;
 	cout << "Output scores in " << output << endl;
 	cout << "Computing scores : ";
@@ -140,6 +388,16 @@ int main(int argc, char *argv[])
 
 	cout << endl;
 	cout << "Smoothing parameter : " << smoothingParam << endl;
+
+	if (threads > 1) {
+		cout << "Scoring with " << threads << " threads" << endl;
+	}
+
+	if (topK > 0) {
+		cout << "Only the " << topK << " best candidates by score #" <<
+			 topKScore << " will be output" << endl;
+	}
+
 	Parser parser(statisticsFile, SEP_WORDS, SEP_FACTORS, SEP_SECTIONS);
 	int nSections = parser.getNumberOfSections();
 	bool immediateContext = false;
@@ -152,25 +410,43 @@ int main(int argc, char *argv[])
 		immediateContext = true;
 	}
 
-	int maxScore = *std::max_element(toCompute.begin(), toCompute.end());
-
-	if (maxScore > 55 && !immediateContext) {
-		cerr << "Error: score #" << maxScore;
-		cerr << " impossible to process without immediate context" << endl;
-		exit(1);
-	}
+	for (int score : toCompute) {
+		if (score > 55 && score <= 60 && !immediateContext) {
+			cerr << "Error: score #" << score;
+			cerr << " impossible to process without immediate context" << endl;
+			exit(1);
+		}
 
-	if (maxScore > 60 && !broadContext) {
-		cerr << "Error: score #" << maxScore;
-		cerr << " impossible to process without broad context" << endl;
-		exit(1);
+		if (score > 60 && score <= 82 && !broadContext) {
+			cerr << "Error: score #" << score;
+			cerr << " impossible to process without broad context" << endl;
+			exit(1);
+		}
 	}
 
 	ScoreCalculator sc(immediateContext, broadContext,
 					   toCompute, smoothingParam);
-	string s;
-	std::vector<std::string> section, types;
-	std::vector<int> contingencyTable(16); // 16 is the size for n = 4
+	// When no score needs contexts, the types are not needed
+	bool batchMode = sc.canComputeBatch();
+	// The one type candidates are read from the stat file until the first
+	// candidate, and saved then, unless they can be loaded from unigramsFile :
+	// it must have been saved from this stat file, as it is now
+	bool typesLoaded = false;
+	bool typesSaved = unigramsFile.empty() || batchMode || !broadContext;
+	unsigned long long statisticsIdentity = getFileIdentity(statisticsFile);
+
+	if (!typesSaved && ifstream(unigramsFile.c_str()).good()) {
+		typesLoaded = sc.loadTypes(unigramsFile, statisticsIdentity);
+		typesSaved = typesLoaded;
+
+		if (typesLoaded) {
+			cout << "One type candidates loaded from " << unigramsFile << endl;
+		} else {
+			cerr << "Warning: " << unigramsFile << " is not a valid file of";
+			cerr << " types saved from " << statisticsFile << ", they are";
+			cerr << " read from the stat file and saved again" << endl;
+		}
+	}
 
 	unique_ptr<ofstream> scoreFile(new ofstream(output));
 	if (!*scoreFile) {
@@ -186,77 +462,204 @@ int main(int argc, char *argv[])
 		stream = std::move(scoreFile);
 	}
 
-	while (!parser.endOfFile()) {
-		types = parser.getNextSection();
+	// Candidates are read by batches : while the workers score a batch, the
+	// next one is read. Each worker scores a contiguous part of the batch and
+	// the parts are written in order.
+	vector<string> batch, processing;
+	vector<ScoreCalculator *> workers;
+	vector<thread> running;
+	vector<string> outputs(threads);
+	// Top-k selection : keys[w] holds the key of each line of outputs[w].
+	// The top of the heap is the worst kept line.
+	vector<vector<float> > keys(threads);
+	vector<ScoreCalculator *> rankers;
+	priority_queue<RankedLine> best;
+	long long index = 0;
+
+	if (topK > 0 && batchMode) {
+		for (int w = 0; w < threads; ++w) {
+			rankers.push_back(new ScoreCalculator(false, false,
+												  vector<int>(1, topKScore),
+												  smoothingParam));
+		}
+	}
+	batch.reserve(CANDIDATES_PER_BATCH);
+	bool checkedSize = false;
+	long long cacheLookups = 0;
+	long long cacheHits = 0;
+
+	auto waitBatch = [&] () {
+		for (auto &t : running) {
+			t.join();
+		}
 
-		if (types.size() == 1) { // one type candidate with broad context
-			int freq = std::stoi((parser.getNextSection())[0]);
-			auto context = parseContext(parser.getNextSection());
-			sc.addType(types[0], freq, context.first, context.second);
-		} else { // normal candidate
-			if (broadContext) {
-				// We strip the candidate to keep only comparable factors :
-				// form & lemma
-				vector<string> strippedTypes(types);
-				for (string & t : strippedTypes) {
-					size_t first_sep, second_sep;
-					first_sep = t.find(SEP_FACTORS, 0);
-
-					if (first_sep != string::npos) {
-						second_sep = t.find(SEP_FACTORS, first_sep + 1);
-
-						if (second_sep != string::npos) {
-							t.erase(t.begin() + second_sep, t.end());
-						}
+		running.clear();
+
+		for (int w = 0; w < threads; ++w) {
+			if (topK == 0) {
+				*stream << outputs[w];
+			}
+
+			size_t begin = 0;
+
+			for (float key : keys[w]) {
+				size_t end = outputs[w].find('\n', begin) + 1;
+				RankedLine l;
+				l.key = key;
+				l.index = index++;
+
+				if ((int) best.size() < topK || l < best.top()) {
+					l.line = outputs[w].substr(begin, end - begin);
+					best.push(l);
+
+					if ((int) best.size() > topK) {
+						best.pop();
 					}
 				}
 
-				sc.newCandidate(strippedTypes);
-			} else {
-				sc.newCandidate();
+				begin = end;
 			}
 
-			section = parser.getNextSection();
-			std::transform(section.begin(), section.end(),
-						   contingencyTable.begin(),
-			[] (std::string & s) {
-				return stoi(s);
-			});
-			sc.addContingencyTable(contingencyTable);
+			outputs[w].clear();
+			keys[w].clear();
+		}
 
-			if (immediateContext) {
-				auto context = parseContext(parser.getNextSection());
-				sc.addToImmediateContext(ScoreCalculator::LEFT,
-										 context.first, context.second);
-				context = parseContext(parser.getNextSection());
-				sc.addToImmediateContext(ScoreCalculator::RIGHT,
-										 context.first, context.second);
+		processing.clear();
+	};
+
+	auto runBatch = [&] () {
+		waitBatch();
+		processing.swap(batch);
+
+		if (processing.empty()) {
+			return;
+		}
+
+		// Once k lines are kept, candidates have to beat the worst of them
+		bool prune = !rankers.empty() && (int) best.size() == topK &&
+					 !std::isnan(best.top().key);
+		float threshold = prune ? best.top().key : 0;
+
+		if (threads == 1) {
+			scoreCandidates(sc, processing.cbegin(), processing.cend(),
+							immediateContext, broadContext, outputs[0],
+							topK > 0 ? &keys[0] : 0, keyIndex,
+							prune ? rankers[0] : 0, threshold);
+			return;
+		}
+
+		if (workers.empty()) {
+			for (int w = 0; w < threads; ++w) {
+				workers.push_back(new ScoreCalculator(sc));
 			}
+		}
+
+		int size = processing.size();
+
+		for (int w = 0; w < threads; ++w) {
+			line_iterator begin = processing.cbegin() + (long long) size * w / threads;
+			line_iterator end = processing.cbegin() + (long long) size * (w + 1) / threads;
+			ScoreCalculator *worker = workers[w];
+			string *out = &outputs[w];
+			vector<float> *key = topK > 0 ? &keys[w] : 0;
+			ScoreCalculator *ranker = prune ? rankers[w] : 0;
+			running.push_back(thread([=] () {
+				scoreCandidates(*worker, begin, end, immediateContext,
+								broadContext, *out, key, keyIndex, ranker,
+								threshold);
+			}));
+		}
+	};
 
-			if (immediateContext) {
+	// Score every candidate read so far, and drop the workers which share
+	// the types of sc
+	auto flush = [&] () {
+		runBatch();
+		waitBatch();
+
+		for (ScoreCalculator *w : workers) {
+			cacheLookups += w->getCacheLookups();
+			cacheHits += w->getCacheHits();
+			delete w;
+		}
+
+		workers.clear();
+	};
+
+	while (!parser.endOfFile()) {
+		const string &line = parser.getLine();
+		size_t endOfTypes = line.find(SEP_SECTIONS);
+
+		if (line.empty()) {
+			// nothing to score
+		} else if (line.find(SEP_WORDS) >= endOfTypes) {
+			// one type candidate with broad context
+			if (!batchMode && !typesLoaded) {
+				flush();
+				vector<string> types = parser.getNextSection();
+				int freq = std::stoi((parser.getNextSection())[0]);
 				auto context = parseContext(parser.getNextSection());
-				sc.addToBroadContext(context.first, context.second);
+				sc.addType(types[0], freq, context.first, context.second);
+			}
+		} else { // normal candidate
+			if (!typesSaved) {
+				typesSaved = true;
+
+				if (!sc.saveTypes(unigramsFile, statisticsIdentity)) {
+					cerr << "Warning: could not write " << unigramsFile << endl;
+				}
 			}
 
-			auto scores = sc.compute();
+			if (!checkedSize) {
+				int n = count(line.begin(), line.begin() + endOfTypes, SEP_WORDS) + 1;
 
-			// Output in file
+				if (n > 2 && !sc.onlyNgramScores()) {
+					cerr << "Warning: candidates of " << n << " types. Only scores";
+					cerr << " 101 to 104 are defined for n > 2, the others use";
+					cerr << " the 4 first values of the table" << endl;
+				}
 
-			for (auto it = types.begin(); it != types.end() - 1; ++it) {
-				*stream << *it << SEP_WORDS;
+				checkedSize = true;
 			}
 
-			*stream << types.back() << SEP_SECTIONS;
+			batch.push_back(line);
 
-			for (auto s = scores.begin(); s != scores.end() - 1; ++s) {
-				*stream << std::to_string(*s) << SEP_WORDS;
+			if ((int) batch.size() == CANDIDATES_PER_BATCH) {
+				runBatch();
 			}
-
-			*stream << std::to_string(scores.back()) << endl;
 		}
 
 		parser.goToNextLine();
 	}
 
+	flush();
+
+	if (topK > 0) {
+		vector<RankedLine> kept;
+
+		while (!best.empty()) {
+			kept.push_back(best.top());
+			best.pop();
+		}
+
+		sort(kept.begin(), kept.end());
+
+		for (const RankedLine &l : kept) {
+			*stream << l.line;
+		}
+	}
+
+	for (ScoreCalculator *r : rankers) {
+		delete r;
+	}
+
+	cacheLookups += sc.getCacheLookups();
+	cacheHits += sc.getCacheHits();
+
+	if (cacheLookups > 0) {
+		cout << "Scores found in cache : " << cacheHits << " / " << cacheLookups
+			 << " candidates (" << 100.0 * cacheHits / cacheLookups << "%)" << endl;
+	}
+
 	return 0;
 }
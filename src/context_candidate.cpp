@@ -20,6 +20,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "context_candidate.h"
 
 #include <sstream>
+#include <algorithm>
+#include <utility>
 
 namespace mwer{
 ContextCandidate::ContextCandidate(std::vector<WordType *> v,
@@ -92,10 +94,13 @@ std::string ContextCandidate::outputContingency(int N)
 	int sum_abcd = counter;
 	std::string s = std::to_string(counter);
 
-	for (auto it = subcandidates.begin(); it != subcandidates.end(); ++it) {
-		s.append(" ");
-		s.append(std::to_string((*it)->getFrequency() - counter));
-		sum_abcd += (*it)->getFrequency() - counter;
+	if (!subcandidates.empty()) {
+		for (int mask : contingencyOrder(nW.size())) {
+			int f = subcandidates[mask]->getFrequency() - counter;
+			s.append(" ");
+			s.append(std::to_string(f));
+			sum_abcd += f;
+		}
 	}
 
 	s.append(" ");
@@ -108,15 +113,25 @@ std::string ContextCandidate::outputContingency(int N)
 /**
 * @brief Returns a formatted version of the context c
 *
+* The types are output in the order of their ids.
+*
 * @param c context to output
+* @param typesById types indexed by id
 */
-std::string ContextCandidate::printContext(ContextType c)
+std::string ContextCandidate::printContext(ContextType c,
+										   const std::vector<WordType *> &typesById)
 {
-	Context &context = contexts[c];
+	Context::Entries entries;
 	std::stringstream ss;
 
-	for (auto it = context.begin(); it != context.end() ; ++it) {
-		ss << *it->first << ":" << it->second << " ";
+	if (c == BROAD && broadSummary) {
+		broadSummary->getEntries(entries);
+	} else {
+		contexts[c].getEntries(entries);
+	}
+
+	for (auto &e : entries) {
+		ss << *typesById[e.first] << ":" << e.second << " ";
 	}
 
 	std::string s = ss.str();
@@ -149,41 +164,161 @@ size_t ContextCandidate::hash() const
 
 
 /**
-* @brief store a subcandidate
+* @brief Order of the subcandidates in the contingency table
+*
+* The masks are sorted by number of undefined types, then by
+* @ref CandidateLexCompare : the first undefined types come last.
+*
+* The orders are built once for every size of candidate (at most 4 types),
+* so they can be read by several threads.
 *
-* We do not check if it's already been inserted, but it is supposed to be once.
+* @param n Number of types of the candidate
 *
+* @return masks in the order of the contingency table
+*/
+const std::vector<int> &ContextCandidate::contingencyOrder(int n)
+{
+	static const std::vector<std::vector<int> > orders = []() {
+		std::vector<std::vector<int> > built(5);
+
+		for (int size = 2; size < (int) built.size(); ++size) {
+			// sort key : number of undefined types, then the mask read from the
+			// first type
+			std::vector<std::pair<int, int> > keys;
+
+			for (int mask = 1; mask < (1 << size) - 1; ++mask) {
+				int wildcards = 0;
+				int reversed = 0;
+
+				for (int i = 0; i < size; ++i) {
+					wildcards += (mask >> i) & 1;
+					reversed = (reversed << 1) | ((mask >> i) & 1);
+				}
+
+				keys.push_back(std::make_pair((wildcards << size) + reversed, mask));
+			}
+
+			std::sort(keys.begin(), keys.end());
+
+			for (auto &k : keys) {
+				built[size].push_back(k.second);
+			}
+		}
+
+		return built;
+	}();
+
+	return orders[n];
+}
+
+
+
+/**
+* @brief store a subcandidate
+*
+* @param mask Undefined types of the subcandidate
 * @param c subcandidate
 */
-void ContextCandidate::addSubcandidate(ContextCandidate *c)
+void ContextCandidate::addSubcandidate(int mask, ContextCandidate *c)
+{
+	if (subcandidates.empty()) {
+		subcandidates.resize(1 << nW.size(), 0);
+	}
+
+	subcandidates[mask] = c;
+}
+
+
+
+/**
+* @brief Add count occurrences of type to the context c
+*/
+void ContextCandidate::addToContext(ContextType c, WordType *type, int count)
 {
-	subcandidates.insert(c);
+	if (c == BROAD && broadSummary) {
+		broadSummary->add(type->getId(), count);
+	} else {
+		contexts[c].add(type->getId(), count);
+	}
 }
 
 
 
 /**
-* @brief Add type to the context c
+* @brief Keep only the k heaviest types of the broad context
+*
+* The counts are then approximated (see @ref SpaceSaving).
+*
+* @param k Maximal number of types in the broad context
 */
-void ContextCandidate::addToContext(ContextType c, WordType *type)
+void ContextCandidate::limitBroadContext(int k)
 {
-	Context &context = contexts[c];
-	++context[type];
+	broadSummary.reset(new SpaceSaving(k));
 }
 
 
+
 /**
-* @brief Update the statistics of the candidate as if it had been seen.
+* @brief Count several occurrences of the candidate at once
 *
-* Upgrade recursively every subcandidate
+* @param count number of occurrences
+*/
+void ContextCandidate::countOccurrences(int count)
+{
+	counter += count;
+}
+
+
+/**
+* @brief Build a candidate with the same types, but without statistics nor
+* subcandidates
 *
+* @return new candidate
 */
-void ContextCandidate::updateStatistics()
+ContextCandidate *ContextCandidate::emptyCopy() const
 {
-	++counter;
+	ContextCandidate *c = new ContextCandidate(nW, parentIds, 0, order);
 
-	for (auto it = subcandidates.begin(); it != subcandidates.end(); ++it) {
-		(*it)->updateStatistics();
+	if (broadSummary) {
+		c->limitBroadContext(broadSummary->getCapacity());
+	}
+
+	return c;
+}
+
+
+
+/**
+* @brief Add the statistics of a candidate counted on another part of the
+* corpus
+*
+* @param other candidate with the same types
+*/
+void ContextCandidate::merge(ContextCandidate &other)
+{
+	counter += other.counter;
+
+	for (unsigned int c = 0; c < other.contexts.size(); ++c) {
+		contexts[c].merge(other.contexts[c]);
+	}
+
+	if (broadSummary && other.broadSummary) {
+		broadSummary->merge(*other.broadSummary);
+	}
+}
+
+
+
+/**
+* @brief Add the occurrences of the candidate to its subcandidates
+*
+* Each occurrence of the candidate is an occurrence of every subcandidate.
+* This must be called once, after the corpus pass.
+*/
+void ContextCandidate::countInSubcandidates()
+{
+	for (int mask = 1; mask + 1 < (int) subcandidates.size(); ++mask) {
+		subcandidates[mask]->counter += counter;
 	}
 }
 
@@ -207,17 +342,11 @@ int ContextCandidate::getSize() const
 */
 void ContextCandidate::substractTypesInContext()
 {
-	Context &broad = contexts[BROAD];
-
 	for (auto & t : nW) {
-		auto i = broad.find(t);
-
-		if (i != broad.end()) {
-			i->second -= counter;
-
-			if (i->second == 0) {
-				broad.erase(i);
-			}
+		if (broadSummary) {
+			broadSummary->subtract(t->getId(), counter);
+		} else {
+			contexts[BROAD].subtract(t->getId(), counter);
 		}
 	}
 }
@@ -20,13 +20,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #ifndef CONTEXT_CANDIDATE_H_
 #define CONTEXT_CANDIDATE_H_
 
-#include <set>
-#include <unordered_map>
 #include <vector>
 #include <string>
+#include <memory>
 
 #include "candidate.h"
 #include "word_type.h"
+#include "context_store.h"
+#include "space_saving.h"
 
 
 namespace mwer{
@@ -35,31 +36,48 @@ namespace mwer{
 *
 * We use the term subcandidate to call candidates containing undefined types.
 * They are useful to count marginal laws of candidates counts.
+*
+* During the corpus pass, only the occurrences of the candidate itself are
+* counted. They are added to its subcandidates afterwards, once, by
+* @ref countInSubcandidates.
+*
+* The subcandidates of a candidate of n types are indexed by a wildcard
+* mask : bit i is set if the type i is undefined. Masks go from 1 to
+* 2^n - 2.
 */
 class ContextCandidate : public Candidate {
 	public:
-		typedef std::unordered_map<WordType *, int> Context;
+		typedef ContextStore Context;
 
 		enum ContextType {BROAD, LEFT, RIGHT};
 
 	protected:
 		std::vector<Context> contexts;
+		// if not null, replaces the broad context (see limitBroadContext)
+		std::unique_ptr<SpaceSaving> broadSummary;
 
-		std::set<AbstractCandidate *, CandidateLexCompare> subcandidates;
+		std::vector<ContextCandidate *> subcandidates; // indexed by mask
 
 	public:
+		static const std::vector<int> &contingencyOrder(int n);
+
 		ContextCandidate(std::vector<WordType *> v, std::vector<int> pids,
 						 int f, int order = 0);
 
 		std::ostream &output(std::ostream &);
 		size_t hash() const;
 
-		void addSubcandidate(ContextCandidate *);
-		void addToContext(ContextType, WordType *);
-		void updateStatistics();
+		void addSubcandidate(int mask, ContextCandidate *);
+		void limitBroadContext(int k);
+		void addToContext(ContextType, WordType *, int count = 1);
+		void countOccurrences(int count);
+		ContextCandidate *emptyCopy() const;
+		void merge(ContextCandidate &other);
+		void countInSubcandidates();
 		int getSize() const;
 		std::string outputContingency(int N);
-		std::string printContext(ContextType c);
+		std::string printContext(ContextType c,
+								 const std::vector<WordType *> &typesById);
 		void substractTypesInContext();
 };
 }
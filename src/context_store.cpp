@@ -0,0 +1,215 @@
+/*
+mwer : multi-word expressions extractor
+Copyright (C) 2013  Tom Bosc
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "context_store.h"
+
+#include <algorithm>
+
+namespace mwer{
+ContextStore::ContextStore() :
+	nPacked(0)
+{
+}
+
+
+
+/**
+* @brief Append a variable-length integer (7 bits per byte)
+*/
+void ContextStore::encode(std::vector<unsigned char> &out, unsigned int v)
+{
+	while (v >= 0x80) {
+		out.push_back((v & 0x7f) | 0x80);
+		v >>= 7;
+	}
+
+	out.push_back(v);
+}
+
+
+
+/**
+* @brief Read a variable-length integer and move past it
+*/
+unsigned int ContextStore::decode(const unsigned char *&in)
+{
+	unsigned int v = 0;
+	int shift = 0;
+
+	while (*in & 0x80) {
+		v |= (unsigned int)(*in & 0x7f) << shift;
+		shift += 7;
+		++in;
+	}
+
+	v |= (unsigned int)(*in) << shift;
+	++in;
+	return v;
+}
+
+
+
+/**
+* @brief Merge the buffer into the sorted entries
+*
+* Entries whose count falls to 0 are dropped.
+*/
+void ContextStore::compact()
+{
+	if (pending.empty()) {
+		return;
+	}
+
+	std::sort(pending.begin(), pending.end());
+	Entries stored;
+	unpack(stored);
+	std::vector<unsigned char> out;
+	out.reserve(packed.size() + 2 * pending.size());
+	nPacked = 0;
+	int previous = 0;
+	auto s = stored.begin();
+	auto p = pending.begin();
+
+	while (s != stored.end() || p != pending.end()) {
+		int id;
+		int count = 0;
+
+		if (p == pending.end() || (s != stored.end() && s->first <= p->first)) {
+			id = s->first;
+		} else {
+			id = p->first;
+		}
+
+		for (; s != stored.end() && s->first == id; ++s) {
+			count += s->second;
+		}
+
+		for (; p != pending.end() && p->first == id; ++p) {
+			count += p->second;
+		}
+
+		if (count != 0) {
+			encode(out, id - previous);
+			// zigzag, in case of a negative count
+			encode(out, ((unsigned int) count << 1) ^ (count >> 31));
+			previous = id;
+			++nPacked;
+		}
+	}
+
+	// the buffers are released, so that a context which is not growing only
+	// holds its packed entries
+	std::vector<unsigned char>(out.begin(), out.end()).swap(packed);
+	Entries().swap(pending);
+}
+
+
+
+/**
+* @brief Count occurrences of a type
+*
+* @param id id of the type
+* @param count number of occurrences
+*/
+void ContextStore::add(int id, int count)
+{
+	pending.push_back(std::make_pair(id, count));
+
+	if ((int) pending.size() >= std::max(nPacked, 16)) {
+		compact();
+	}
+}
+
+
+
+/**
+* @brief Add the occurrences counted in another context
+*/
+void ContextStore::merge(ContextStore &other)
+{
+	Entries entries;
+
+	for (auto &e : other.getEntries(entries)) {
+		add(e.first, e.second);
+	}
+}
+
+
+
+/**
+* @brief Remove occurrences of a type, if it is in the context
+*
+* @param id id of the type
+* @param count number of occurrences
+*/
+void ContextStore::subtract(int id, int count)
+{
+	Entries entries;
+
+	for (auto &e : getEntries(entries)) {
+		if (e.first == id) {
+			add(id, -count);
+			break;
+		}
+	}
+}
+
+
+
+/**
+* @brief Decode the context
+*
+* @param entries vector to fill
+*
+* @return (type id, count) sorted by id
+*/
+const ContextStore::Entries &ContextStore::getEntries(Entries &entries)
+{
+	compact();
+	unpack(entries);
+	return entries;
+}
+
+
+
+/**
+* @brief Decode the sorted entries, without the buffer
+*/
+void ContextStore::unpack(Entries &entries) const
+{
+	entries.clear();
+	entries.reserve(nPacked);
+	const unsigned char *in = packed.data();
+	int id = 0;
+
+	for (int i = 0; i < nPacked; ++i) {
+		id += decode(in);
+		unsigned int z = decode(in);
+		entries.push_back(std::make_pair(id, (int)(z >> 1) ^ -(int)(z & 1)));
+	}
+}
+
+
+
+bool ContextStore::empty()
+{
+	compact();
+	return nPacked == 0;
+}
+}
@@ -0,0 +1,61 @@
+/*
+mwer : multi-word expressions extractor
+Copyright (C) 2013  Tom Bosc
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef CONTEXT_STORE_H_
+#define CONTEXT_STORE_H_
+
+#include <vector>
+#include <utility>
+
+namespace mwer{
+/**
+* @brief A compact multiset of word types, used as a context
+*
+* Occurrences are appended as (type id, count) to a buffer. When the buffer
+* is as large as the stored entries, it is sorted and merged into them. The
+* entries are kept sorted by id, delta-encoded as variable-length integers :
+* most entries take 2 or 3 bytes instead of a node of a hash map. The buffer
+* is released after each merge.
+*/
+class ContextStore {
+	public:
+		typedef std::vector<std::pair<int, int> > Entries;
+
+	private:
+		Entries pending;
+		std::vector<unsigned char> packed;
+		int nPacked; // number of entries in packed
+
+		static void encode(std::vector<unsigned char> &out, unsigned int v);
+		static unsigned int decode(const unsigned char *&in);
+		void unpack(Entries &entries) const;
+		void compact();
+
+	public:
+		ContextStore();
+
+		void add(int id, int count = 1);
+		void merge(ContextStore &other);
+		void subtract(int id, int count);
+		const Entries &getEntries(Entries &entries);
+		bool empty();
+};
+}
+
+#endif
@@ -0,0 +1,26 @@
+#! /usr/bin/env python
+import sys
+import argparse
+
+from tools import FileType, Model
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="""
+                        Exports a linear model as text, for rank_candidates""")
+    parser.add_argument('-m', dest = 'input_model',
+                        type = Model(), required = True,
+                        help = "file containing model configuration")
+    parser.add_argument('-o', dest = 'output_model',
+                        type = FileType('w'), required = True,
+                        help = "file that will contain the exported model")
+
+    try: 
+        args = parser.parse_args()
+    except IOError as e:
+        print "Error: " + e.filename + " : " + e.strerror
+        sys.exit(1)
+
+    model = args.input_model
+    print "Exporting model", model.name
+    print "in file", args.output_model.name
+    model.export(args.output_model)
@@ -39,15 +39,19 @@ int main(int argc, char *argv[])
 	string tagFilter;
 	int minFreqFilter = -1;
 	int maxFreqFilter = -1;
-	int n = -1;
+	int nMin = -1;
+	int nMax = -1;
 	int minSurfaceDistance = -1;
 	int maxSurfaceDistance = -1;
-	int dependencyFlag = -1;
+	int dependencyFlag = 0;
+	int surfaceFlag = 0;
 	int adjacentFlag = 0;
+	int cacheSize = 0;
+	double budget = 0;
 	opterr = 0;
 	static struct option long_options[] = {
 		// flags
-		{"surface",   no_argument, &dependencyFlag, 0},
+		{"surface",   no_argument, &surfaceFlag, 1},
 		{"adjacent",   no_argument, &adjacentFlag, 1},
 		{"dependency",   no_argument, &dependencyFlag, 1},
 		{"help",  no_argument, 0, 'h'},
@@ -59,6 +63,8 @@ int main(int argc, char *argv[])
 		{"output",    required_argument, 0, 'o'},
 		{"distance-range", required_argument, 0, 'r'},
 		{"tag-filter", required_argument, 0, 't'},
+		{"sentence-cache", required_argument, 0, 'C'},
+		{"sentence-budget", required_argument, 0, 'B'},
 		{0, 0, 0, 0}
 	};
 	int option_index;
@@ -80,14 +86,16 @@ int main(int argc, char *argv[])
 				corpus = optarg;
 				break;
 
-			case 'd':
-				if (dependencyFlag == -1) {
-					dependencyFlag = 1;
-				} else {
-					cerr << "Error: you already selected dependency extraction (-d)";
-					cerr << endl;
-				}
+			case 'B':
+				budget = atof(optarg);
+				break;
 
+			case 'C':
+				cacheSize = atoi(optarg);
+				break;
+
+			case 'd':
+				dependencyFlag = 1;
 				break;
 
 			case 'f':
@@ -96,21 +104,25 @@ int main(int argc, char *argv[])
 
 			case 'h':
 				cout << "extract_candidates : Extracts MWE candidates." << endl;
-				cout << "extract_candidates -n {2,3,4} -c CORPUS_FILE -o OUTPUT_FILE";
-				cout << endl << " {-d|-s} [-a] [-r dist_min-dist_max] [-f min-max]" << endl;
+				cout << "extract_candidates -n {2,3,4,min-max} -c CORPUS_FILE -o OUTPUT_FILE";
+				cout << endl << " {-d|-s|-d -s} [-a] [-r dist_min-dist_max] [-f min-max]" << endl;
 				cout << "[-l regexp1:...:regexpn] [-t regexp1:...:regexpn]" << endl;
 				cout << "Mandatory : " << endl;
-				cout << "  -n : 2,3 or 4" << endl;
+				cout << "  -n : 2,3 or 4, or a range such as 2-4 (one output file per n)" << endl;
 				cout << "  -c : input corpus file" << endl;
 				cout << "  -o : output candidates file" << endl;
-				cout << "  -d, --dependency	: dependency extraction OR" <<endl;
-				cout << "  -s, --surface : surface extraction" << endl;
+				cout << "  -d, --dependency	: dependency extraction AND/OR" <<endl;
+				cout << "  -s, --surface : surface extraction (one output file per extraction)" << endl;
 				cout << "Optional : " << endl;
 				cout << "  -a, --adjacent : extract candidates that are adjacent only" << endl;
 				cout << "  -r min-max : distance filter (accept matchs)" << endl;
 				cout << "  -f min-max : frequency filter (accept matchs)" << endl;
 				cout << "  -l regexp1:...:regexpn : regex filter for lemmas (accept matchs)" << endl;
 				cout << "  -t regexp1:...:regexpn : regex filter for tags (accept matchs)" << endl;
+				cout << "  --sentence-cache size : replay the candidates of the last size" << endl;
+				cout << "                          distinct sentences when they are repeated" << endl;
+				cout << "  --sentence-budget max : skip the sentences which would need more" << endl;
+				cout << "                          than max combinations to enumerate" << endl;
 				exit(0);
 
 			case 'l':
@@ -118,7 +130,12 @@ int main(int argc, char *argv[])
 				break;
 
 			case 'n':
-				n = atoi(optarg);
+				getRange(string(optarg), nMin, nMax);
+
+				if (string(optarg).find(SEP_RANGE) == string::npos) {
+					nMax = nMin;
+				}
+
 				break;
 
 			case 'o':
@@ -130,12 +147,7 @@ int main(int argc, char *argv[])
 				break;
 
 			case 's':
-				if (dependencyFlag == -1) {
-					dependencyFlag = 0;
-				} else {
-					cerr << "Error: you already selected surface extraction (-s)" << endl;
-				}
-
+				surfaceFlag = 1;
 				break;
 
 			case 't':
@@ -173,34 +185,35 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	if (n < 2 || n > 4) {
+	if (nMin < 2 || nMax > 4 || nMax < nMin) {
 		cerr << "Error: n must be between 2 and 4" << std::endl;
 		return 1;
 	}
 
-	if (dependencyFlag == -1) {
-		cerr << "Error: Choose between syntactical (-d) or surface (-s) extraction"
+	if (nMin != nMax && (!lemmaFilter.empty() || !tagFilter.empty())) {
+		cerr << "Error: regex filters (-l, -t) can only be used with a single n"
 			 << endl;
 		return 1;
 	}
 
-	if (adjacentFlag == 1) {
-		minSurfaceDistance = n - 1;
-		maxSurfaceDistance = n - 1;
+	if (dependencyFlag == 0 && surfaceFlag == 0) {
+		cerr << "Error: Choose syntactical (-d) and/or surface (-s) extraction"
+			 << endl;
+		return 1;
 	}
 
-	cout << "Looking for " << n << "-grams" << endl;
+	if (nMin == nMax) {
+		cout << "Looking for " << nMin << "-grams" << endl;
+	} else {
+		cout << "Looking for " << nMin << "-grams to " << nMax << "-grams" << endl;
+	}
 
-	if (minSurfaceDistance >= 1 && maxSurfaceDistance >= minSurfaceDistance) {
+	if (adjacentFlag == 0 && minSurfaceDistance >= 1 &&
+			maxSurfaceDistance >= minSurfaceDistance) {
 		cout << "Accepted range of distance between each words of a candidate : ";
 		cout << minSurfaceDistance << "-" << maxSurfaceDistance << endl;
-	}
-
-	cout << "Output file : " << outputFile << endl;
-
-	if (minSurfaceDistance == -1 && maxSurfaceDistance == -1) {
-		minSurfaceDistance = n - 1;
-		maxSurfaceDistance = std::numeric_limits<int>::max();
+	} else if (adjacentFlag == 1) {
+		cout << "Accepting adjacent candidates only" << endl;
 	}
 
 	int nFactors = 1;
@@ -209,9 +222,68 @@ int main(int argc, char *argv[])
 	Parser p(corpus, SEP_WORDS, SEP_FACTORS);
 
 	nFactors = p.getNumberOfFactors();
-	ce = new CandidateExtractor<Candidate>(n, nFactors, 
-										   minSurfaceDistance, maxSurfaceDistance,
-										   (bool) dependencyFlag);
+
+	// dependency and surface tables are filled from the same tokens
+	vector<bool> modes;
+
+	if (dependencyFlag == 1) {
+		modes.push_back(true);
+	}
+
+	if (surfaceFlag == 1) {
+		modes.push_back(false);
+	}
+
+	for (bool dependency : modes) {
+		for (int n = nMin; n <= nMax; ++n) {
+			int minDistance = minSurfaceDistance;
+			int maxDistance = maxSurfaceDistance;
+
+			if (adjacentFlag == 1) {
+				minDistance = n - 1;
+				maxDistance = n - 1;
+			}
+
+			if (minDistance == -1 && maxDistance == -1) {
+				minDistance = n - 1;
+				maxDistance = std::numeric_limits<int>::max();
+			}
+
+			if (ce == 0) {
+				ce = new CandidateExtractor<Candidate>(n, nFactors,
+													   minDistance, maxDistance,
+													   dependency);
+			} else {
+				ce->addTable(n, dependency, minDistance, maxDistance);
+			}
+		}
+	}
+
+	if (cacheSize > 0) {
+		cout << "Caching the last " << cacheSize << " distinct sentences" << endl;
+		ce->setSentenceCache(cacheSize);
+	}
+
+	if (budget > 0) {
+		ce->setSentenceBudget(budget);
+	}
+
+	// one output file per table, named after the extraction parameters
+	vector<string> outputFiles;
+
+	for (int i = 0; i < ce->getNumberOfTables(); ++i) {
+		const CandidateExtractor<Candidate>::Table &table = ce->getTable(i);
+
+		if (ce->getNumberOfTables() == 1) {
+			outputFiles.push_back(outputFile);
+		} else {
+			string suffix = (table.dependency) ? "d" : "s";
+			suffix.append("n" + std::to_string(table.n));
+			outputFiles.push_back(insertSuffix(outputFile, suffix));
+		}
+
+		cout << "Output file : " << outputFiles.back() << endl;
+	}
 
 	cout << "Reading corpus : " << corpus << endl;
 
@@ -236,24 +308,28 @@ int main(int argc, char *argv[])
 		p.goToNextLine();
 	}
 
-	if (nFactors > LEMMA && !lemmaFilter.empty()) {
-		cout << "Applying the lemma filter : " << lemmaFilter << endl;
-		ce->regexpFilter(LEMMA, lemmaFilter);
-	}
+	ce->printRunStatistics(cout);
 
-	if (nFactors > TAG && !tagFilter.empty()) {
-		cout << "Applying the tag filter : " << tagFilter << endl;
-		ce->regexpFilter(TAG, tagFilter);
-	}
+	for (int i = 0; i < ce->getNumberOfTables(); ++i) {
+		CandidateFilter<Candidate> *table = ce->getTable(i).filter;
 
-	if (minFreqFilter >= 1 && maxFreqFilter >= minFreqFilter) {
-		cout << "Applying the frequency filter within the range ";
-		cout << minFreqFilter << "-" << maxFreqFilter << endl;
-		ce->frequencyFilter(minFreqFilter, maxFreqFilter);
-	}
+		if (nFactors > LEMMA && !lemmaFilter.empty()) {
+			cout << "Applying the lemma filter : " << lemmaFilter << endl;
+			table->regexpFilter(LEMMA, lemmaFilter);
+		}
+
+		if (nFactors > TAG && !tagFilter.empty()) {
+			cout << "Applying the tag filter : " << tagFilter << endl;
+			table->regexpFilter(TAG, tagFilter);
+		}
+
+		if (minFreqFilter >= 1 && maxFreqFilter >= minFreqFilter) {
+			cout << "Applying the frequency filter within the range ";
+			cout << minFreqFilter << "-" << maxFreqFilter << endl;
+			table->frequencyFilter(minFreqFilter, maxFreqFilter);
+		}
 
-	if (ce != 0) {
-		ce->writeToFile(outputFile);
+		table->writeToFile(outputFiles[i]);
 	}
 
 	delete ce;
@@ -44,6 +44,10 @@ int main(int argc, char *argv[])
 	int immediateFlag = 0;
 	int broadFlag = 0;
 	int adjacentFlag = -1;
+	int cacheSize = 0;
+	double budget = 0;
+	int threads = 1;
+	int contextTopK = 0;
 	opterr = 0;
 	static struct option long_options[] = {
 		// flags
@@ -60,6 +64,10 @@ int main(int argc, char *argv[])
 		{"n",    required_argument, 0, 'n'},
 		{"output",    required_argument, 0, 'o'},
 		{"distance-range", required_argument, 0, 'r'},
+		{"sentence-cache", required_argument, 0, 'C'},
+		{"sentence-budget", required_argument, 0, 'B'},
+		{"threads", required_argument, 0, 'T'},
+		{"context-top-k", required_argument, 0, 'K'},
 		{0, 0, 0, 0}
 	};
 	int option_index;
@@ -75,6 +83,14 @@ int main(int argc, char *argv[])
 				corpus = optarg;
 				break;
 
+			case 'B':
+				budget = atof(optarg);
+				break;
+
+			case 'C':
+				cacheSize = atoi(optarg);
+				break;
+
 			case 'd':
 				dependencyFlag = 1;
 				break;
@@ -101,8 +117,19 @@ int main(int argc, char *argv[])
 				cout << "  -t regexp1:...:regexpn : regex filter for tags of context (accept matchs)" << endl;
 				cout << "  --immediate : process immediate context" << endl;
 				cout << "  --broad : process broad context" << endl;
+				cout << "  --sentence-cache size : replay the occurrences of the last size" << endl;
+				cout << "                          distinct sentences when they are repeated" << endl;
+				cout << "  --sentence-budget max : skip the sentences which would need more" << endl;
+				cout << "                          than max combinations to enumerate" << endl;
+				cout << "  --threads n : number of threads counting the occurrences" << endl;
+				cout << "  --context-top-k k : keep only the k heaviest types of each" << endl;
+				cout << "                      broad context (approximated counts)" << endl;
 				return 0;
 
+			case 'K':
+				contextTopK = atoi(optarg);
+				break;
+
 			case 'n':
 				n = atoi(optarg);
 				break;
@@ -123,6 +150,10 @@ int main(int argc, char *argv[])
 				tagFilter = optarg;
 				break;
 
+			case 'T':
+				threads = atoi(optarg);
+				break;
+
 			case '?':
 				cout << "Error: unrecognized option -" << (char) optopt <<
 					 " OR missing argument" << endl;
@@ -148,6 +179,16 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
+	if (contextTopK < 0) {
+		cerr << "Error: the number of types per context must be positive" << endl;
+		return 1;
+	}
+
+	if (threads < 1) {
+		cerr << "Error: the number of threads must be at least 1" << endl;
+		return 1;
+	}
+
 	if (n < 2 || n > 4) {
 		cerr << "Error: n must be between 2 and 4" << endl;
 		return 1;
@@ -195,6 +236,21 @@ int main(int argc, char *argv[])
 	StatisticExtractor se(n, nFactorsCorpus, minSurfaceDistance,
 						  maxSurfaceDistance, (bool) dependencyFlag,
 						  (bool) immediateFlag, (bool) broadFlag, tagFilter);
+	if (cacheSize > 0) {
+		cout << "Caching the last " << cacheSize << " distinct sentences" << endl;
+		se.setSentenceCache(cacheSize);
+	}
+
+	if (budget > 0) {
+		se.setSentenceBudget(budget);
+	}
+
+	if (contextTopK > 0 && broadFlag) {
+		cout << "Keeping the " << contextTopK << " heaviest types of broad contexts"
+			 << endl;
+		se.setContextTopK(contextTopK);
+	}
+
 	string s;
 	vector<int> parentIds;
 	parentIds.reserve(n);
@@ -227,6 +283,11 @@ int main(int argc, char *argv[])
 		candidatesParser.goToNextLine();
 	}
 
+	if (threads > 1) {
+		cout << "Counting with " << threads << " threads" << endl;
+		se.setThreads(threads);
+	}
+
 	while (!textParser.endOfFile()) {
 		for (int i = 0; i < textParser.getNumberOfTokens(); i++) {
 			s = textParser.getNextToken();
@@ -238,6 +299,7 @@ int main(int argc, char *argv[])
 	}
 
 	se.finish();
+	se.printRunStatistics(cout);
 	se.writeToFile(outputFile);
 	return 0;
 }
@@ -104,7 +104,7 @@ void Parser::goToNextLine()
 		nSepWords = count(currentLine.begin(), currentLine.end(), sep_tokens) + 1;
 		offsetToken = 0;
 		offsetSections = 0;
-		sections = split(currentLine, sep_sections);
+		sections.clear(); // split when the first section is read
 	} else {
 		eof = true;
 	}
@@ -136,10 +136,26 @@ string Parser::getNextToken()
 */
 vector<string> Parser::getNextSection()
 {
+	if (offsetSections == 0) {
+		sections = split(currentLine, sep_sections);
+	}
+
 	return split(sections[offsetSections++], sep_tokens);
 }
 
 
+
+/**
+* @brief
+*
+* @return the current line, as read in the file
+*/
+const string &Parser::getLine() const
+{
+	return currentLine;
+}
+
+
 /**
 * @brief
 *
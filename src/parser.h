@@ -59,6 +59,7 @@ class Parser {
 		void goToNextLine();
 		std::string getNextToken();
 		std::vector<std::string> getNextSection();
+		const std::string &getLine() const;
 
 		bool endOfFile() const;
 		int getNumberOfTokens() const;
@@ -0,0 +1,378 @@
+/*
+mwer : multi-word expressions extractor
+Copyright (C) 2013  Tom Bosc
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <iostream>
+#include <string>
+#include <getopt.h>
+#include <algorithm>
+#include <fstream>
+#include <utility>
+#include <memory>
+#include <vector>
+#include <queue>
+#include <cmath>
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+
+#include "shared.h"
+
+using namespace mwer;
+using namespace std;
+
+/**
+* @brief Linear model exported by export_model.py
+*
+* rank = sum(weights[i] * (score[i] - means[i]) / scales[i]) + intercept
+*/
+struct LinearModel {
+	vector<double> means;
+	vector<double> scales;
+	vector<double> weights;
+	double intercept;
+};
+
+/**
+* @brief Ranked candidate
+*
+* Candidates are ordered by decreasing rank, then in the order of the input.
+*/
+struct RankedCandidate {
+	double rank;
+	long long index;
+	string candidate;
+
+	bool operator<(const RankedCandidate &other) const
+	{
+		return rank > other.rank || (rank == other.rank && index < other.index);
+	}
+};
+
+
+
+vector<double> parseValues(const string &s)
+{
+	vector<double> values;
+
+	for (const string &v : split(s, SEP_WORDS)) {
+		if (!v.empty()) {
+			values.push_back(strtod(v.c_str(), 0));
+		}
+	}
+
+	return values;
+}
+
+
+
+/**
+* @brief Read a model exported by export_model.py
+*
+* Each line is a name and its values : means, scales, weights and intercept.
+*
+* @param filename model file
+* @param model read model
+*
+* @return false if the file is not a valid model
+*/
+bool readModel(const string &filename, LinearModel &model)
+{
+	ifstream file(filename.c_str());
+	string line;
+	bool hasIntercept = false;
+
+	while (getline(file, line)) {
+		size_t sep = line.find(SEP_SECTIONS);
+
+		if (sep == string::npos) {
+			continue;
+		}
+
+		string name = line.substr(0, sep);
+		vector<double> values = parseValues(line.substr(sep + 1));
+
+		if (name == "means") {
+			model.means = values;
+		} else if (name == "scales") {
+			model.scales = values;
+		} else if (name == "weights") {
+			model.weights = values;
+		} else if (name == "intercept" && values.size() == 1) {
+			model.intercept = values[0];
+			hasIntercept = true;
+		}
+	}
+
+	return hasIntercept && !model.weights.empty() &&
+		   model.means.size() == model.weights.size() &&
+		   model.scales.size() == model.weights.size();
+}
+
+
+
+/**
+* @brief Rank of a candidate
+*
+* As in apply_model.py, NaN scores are replaced by 0 and infinite scores by
+* the largest finite values before the standardization.
+*
+* @param model linear model
+* @param scores section of the scores of the candidate
+*
+* @return rank of the candidate
+*/
+double computeRank(const LinearModel &model, const vector<double> &scores)
+{
+	double r = model.intercept;
+
+	for (int i = 0; i < (int) model.weights.size(); ++i) {
+		double x = scores[i];
+
+		if (std::isnan(x)) {
+			x = 0.0;
+		} else if (std::isinf(x)) {
+			x = (x > 0) ? DBL_MAX : -DBL_MAX;
+		}
+
+		r += model.weights[i] * (x - model.means[i]) / model.scales[i];
+	}
+
+	return r;
+}
+
+
+
+/**
+* @brief Format a rank as apply_model.py does
+*
+* @return 12 significant digits, with ".0" for integral values
+*/
+string formatRank(double rank)
+{
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.12g", rank);
+	string s(buffer);
+
+	if (s.find_first_of(".eni") == string::npos) {
+		s += ".0";
+	}
+
+	return s;
+}
+
+
+int main(int argc, char *argv[])
+{
+	string scoresFile;
+	string modelFile;
+	string output;
+	bool hasMaxCandidates = false;
+	long long maxCandidates = 0;
+	bool hasThreshold = false;
+	double threshold = 0.0;
+	opterr = 0;
+	static struct option long_options[] = {
+		// flags
+		{"help",  no_argument, 0, 'h'},
+		// parameters with argument
+		{"input", required_argument, 0, 'i'},
+		{"model", required_argument, 0, 'm'},
+		{"output", required_argument, 0, 'o'},
+		{"max-candidates", required_argument, 0, 'n'},
+		{"threshold", required_argument, 0, 't'},
+		{0, 0, 0, 0}
+	};
+	int option_index;
+	int cmdline;
+
+	while ((cmdline = getopt_long(argc, argv, "hi:m:o:n:t:", long_options,
+								  &option_index)) != -1) {
+		switch (cmdline) {
+			case 'i':
+				scoresFile = optarg;
+				break;
+
+			case 'h':
+				cout << "rank_candidates : Applies a linear model and outputs ranking" << endl;
+				cout << "rank_candidates -i input_scores -m input_model -o output_rank" << endl;
+				cout << "[-n max_candidates] [-t threshold]" << endl;
+				cout << "Mandatory : " << endl;
+				cout << "  -i : file containing candidates with scores" << endl;
+				cout << "  -m : model exported by export_model.py" << endl;
+				cout << "  -o : file that will contain ranked candidates" << endl;
+				cout << "Optional : " << endl;
+				cout << "  -n : maximum size of the n-best list to be output" << endl;
+				cout << "  -t : only candidates ranked at least threshold are output" << endl;
+				cout << "Without -n, every candidate kept is held in memory to be" << endl;
+				cout << "sorted : the memory grows with the size of the input." << endl;
+
+				return 0;
+
+			case 'm':
+				modelFile = optarg;
+				break;
+
+			case 'o':
+				output = optarg;
+				break;
+
+			case 'n':
+				hasMaxCandidates = true;
+				maxCandidates = atoll(optarg);
+				break;
+
+			case 't':
+				hasThreshold = true;
+				threshold = strtod(optarg, 0);
+				break;
+
+			case '?':
+				cout << "Error: unrecognized option -" << (char) optopt <<
+					 " OR missing argument" << endl;
+				return 1;
+
+			default:
+				break;
+		}
+	}
+
+	if (scoresFile.empty()) {
+		cerr << "Error: no scores filename provided... use -i" << endl;
+		return 1;
+	}
+
+	if (modelFile.empty()) {
+		cerr << "Error: no model filename provided... use -m" << endl;
+		return 1;
+	}
+
+	if (output.empty()) {
+		cerr << "Error: no ranking output filename provided... use -o" << endl;
+		return 1;
+	}
+
+	if (hasMaxCandidates && maxCandidates < 1) {
+		cerr << "Error: the size of the n-best list must be at least 1" << endl;
+		return 1;
+	}
+
+	LinearModel model;
+
+	if (!readModel(modelFile, model)) {
+		cerr << "Error: Model " << modelFile << " : not a valid model file" << endl;
+		return 1;
+	}
+
+	cout << "Applying model " << modelFile << endl;
+	cout << "on data file " << scoresFile << endl;
+	cout << "Outputting ranking in file " << output << endl;
+
+	if (hasThreshold) {
+		cout << "Only candidates ranked at least " << threshold << " will be output" << endl;
+	}
+
+	if (hasMaxCandidates) {
+		cout << "Only the first " << maxCandidates << " best ranked candidates "
+			 << "will be output" << endl;
+	}
+
+	unique_ptr<ifstream> rawInput(new ifstream(scoresFile));
+	if (!*rawInput) {
+		cerr << "Error: opening file " << scoresFile << endl;
+		return 1;
+	}
+	unique_ptr<istream> input;
+
+	if (getExtension(scoresFile) == ".gz") {
+		input = getUncompressedStream(*rawInput);
+	} else {
+		input = std::move(rawInput);
+	}
+
+	unique_ptr<ofstream> rankFile(new ofstream(output));
+	if (!*rankFile) {
+		cerr << "Error: opening file " << output << endl;
+		return 1;
+	}
+	unique_ptr<ostream> stream;
+
+	if (getExtension(output) == ".gz") {
+		stream = getCompressedStream(*rankFile);
+	} else {
+		stream = std::move(rankFile);
+	}
+
+	// With -n, only the n best candidates are kept : the top of the heap is
+	// the worst of them
+	priority_queue<RankedCandidate> best;
+	vector<RankedCandidate> kept;
+	string line;
+	long long index = 0;
+
+	while (getline(*input, line)) {
+		size_t endOfTypes = line.find(SEP_SECTIONS);
+
+		if (endOfTypes == string::npos) {
+			continue;
+		}
+
+		size_t endOfScores = line.find(SEP_SECTIONS, endOfTypes + 1);
+		vector<double> scores = parseValues(line.substr(endOfTypes + 1,
+											endOfScores - endOfTypes - 1));
+
+		if (scores.size() < model.weights.size()) {
+			cerr << "Error: " << scores.size() << " scores for a model of "
+				 << model.weights.size() << " scores" << endl;
+			return 1;
+		}
+
+		RankedCandidate c;
+		c.rank = computeRank(model, scores);
+		c.index = index++;
+
+		if (hasThreshold && c.rank < threshold) {
+			continue;
+		}
+
+		if (!hasMaxCandidates) {
+			c.candidate = line.substr(0, endOfTypes);
+			kept.push_back(c);
+		} else if ((long long) best.size() < maxCandidates || c < best.top()) {
+			c.candidate = line.substr(0, endOfTypes);
+			best.push(c);
+
+			if ((long long) best.size() > maxCandidates) {
+				best.pop();
+			}
+		}
+	}
+
+	while (!best.empty()) {
+		kept.push_back(best.top());
+		best.pop();
+	}
+
+	sort(kept.begin(), kept.end());
+
+	for (const RankedCandidate &c : kept) {
+		*stream << c.candidate << SEP_SECTIONS << formatRank(c.rank) << '\n';
+	}
+
+	return 0;
+}
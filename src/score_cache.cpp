@@ -0,0 +1,167 @@
+/*
+mwer : multi-word expressions extractor
+Copyright (C) 2013  Tom Bosc
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "score_cache.h"
+
+#include <cstring>
+#include <algorithm>
+
+namespace mwer{
+/**
+* @param keySize Number of values of a key
+* @param nScores Number of scores per key
+* @param nSlots Number of slots, rounded up to a power of 2
+*/
+ScoreCache::ScoreCache(int keySize, int nScores, int nSlots) :
+	keySize(keySize),
+	nScores(nScores),
+	nSlots(1),
+	nLookups(0),
+	nHits(0)
+{
+	while (this->nSlots < nSlots) {
+		this->nSlots *= 2;
+	}
+
+	keys.resize((size_t) this->nSlots * keySize);
+	scores.resize((size_t) this->nSlots * nScores);
+	used.resize(this->nSlots, false);
+	pending.resize(this->nSlots, -1);
+}
+
+
+
+int ScoreCache::slotOf(const float *key) const
+{
+	unsigned long long h = 14695981039346656037ULL; // FNV-1a
+
+	for (int i = 0; i < keySize; ++i) {
+		unsigned int bits;
+		memcpy(&bits, key + i, sizeof(bits));
+		h = (h ^ bits) * 1099511628211ULL;
+	}
+
+	return (h ^ (h >> 32)) & (nSlots - 1);
+}
+
+
+
+/**
+* @brief Look a key up
+*
+* @param key keySize values
+*
+* @return the slot of the key, or -1 if it is not in the cache. The scores of
+* the slot may be pending.
+*/
+int ScoreCache::find(const float *key)
+{
+	int slot = slotOf(key);
+	++nLookups;
+
+	if (used[slot] && std::equal(key, key + keySize,
+								 keys.begin() + (size_t) slot * keySize)) {
+		++nHits;
+		return slot;
+	}
+
+	return -1;
+}
+
+
+
+/**
+* @brief Store a key, replacing the key in its slot
+*
+* @param key keySize values
+* @param pendingIndex index given back by getPending() until the scores of the
+* slot are set
+*
+* @return the slot of the key
+*/
+int ScoreCache::reserve(const float *key, int pendingIndex)
+{
+	int slot = slotOf(key);
+	std::copy(key, key + keySize, keys.begin() + (size_t) slot * keySize);
+	used[slot] = true;
+	pending[slot] = pendingIndex;
+	return slot;
+}
+
+
+
+/**
+* @return the index given to reserve() if the scores are not set yet, else -1
+*/
+int ScoreCache::getPending(int slot) const
+{
+	return pending[slot];
+}
+
+
+
+/**
+* @return nScores values
+*/
+const float *ScoreCache::getScores(int slot) const
+{
+	return scores.data() + (size_t) slot * nScores;
+}
+
+
+
+/**
+* @brief Set the scores of a slot
+*
+* @param slot slot returned by reserve()
+* @param values first score
+* @param stride distance between 2 scores in values
+*/
+void ScoreCache::setScores(int slot, const float *values, int stride)
+{
+	float *s = scores.data() + (size_t) slot * nScores;
+
+	for (int i = 0; i < nScores; ++i) {
+		s[i] = values[(size_t) i * stride];
+	}
+
+	pending[slot] = -1;
+}
+
+
+
+int ScoreCache::getKeySize() const
+{
+	return keySize;
+}
+
+
+
+long long ScoreCache::getLookups() const
+{
+	return nLookups;
+}
+
+
+
+long long ScoreCache::getHits() const
+{
+	return nHits;
+}
+}
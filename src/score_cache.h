@@ -0,0 +1,67 @@
+/*
+mwer : multi-word expressions extractor
+Copyright (C) 2013  Tom Bosc
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef SCORE_CACHE_H_
+#define SCORE_CACHE_H_
+
+#include <vector>
+
+namespace mwer{
+/**
+* @brief A bounded cache of score vectors keyed by contingency tables
+*
+* Many candidates, especially the rare ones, share the same contingency
+* table, and therefore the same scores when no context is used.
+*
+* The cache is direct-mapped : a table can only be stored in the slot given
+* by its hash, and replaces the table previously stored there. Keys have a
+* fixed number of values.
+*
+* A slot can be reserved before its scores are computed : it is then
+* pending, and holds the index given by the caller until its scores are set.
+*/
+class ScoreCache {
+	private:
+		int keySize;
+		int nScores;
+		int nSlots; // power of 2
+		std::vector<float> keys; // keySize values per slot
+		std::vector<float> scores; // nScores values per slot
+		std::vector<bool> used;
+		std::vector<int> pending; // -1 if the scores are set
+		long long nLookups;
+		long long nHits;
+
+		int slotOf(const float *key) const;
+
+	public:
+		ScoreCache(int keySize, int nScores, int nSlots);
+
+		int find(const float *key);
+		int reserve(const float *key, int pendingIndex = -1);
+		int getPending(int slot) const;
+		const float *getScores(int slot) const;
+		void setScores(int slot, const float *values, int stride = 1);
+		int getKeySize() const;
+		long long getLookups() const;
+		long long getHits() const;
+};
+}
+
+#endif
@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "score_calculator.h"
+#include "context_candidate.h"
 
 #include <cmath>
 #include <algorithm>
@@ -26,34 +27,100 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <functional>
 #include <numeric>
 
+#define SCORE_CACHE_SLOTS 65536
+
 namespace mwer{
 using namespace std::placeholders;
 using namespace std;
 
+/**
+* @brief Find the first entry of a context with an id not lower than id
+*
+* Galloping search : the step doubles until an entry with a greater or equal id
+* is found, then a binary search is done in the last step. It is cheap when
+* the entry is close to the start, as during the intersection of contexts of
+* similar sizes, and logarithmic when it is far.
+*
+* @param it first entry to consider
+* @param end end of the context
+* @param id type id to look for
+*
+* @return the first entry with an id >= id, or end
+*/
+static inline const pair<int, float> *gallop(const pair<int, float> *it,
+		const pair<int, float> *end, int id)
+{
+	int step = 1;
+	const pair<int, float> *low = it;
+
+	while (it < end && it->first < id) {
+		low = it + 1;
+		it = (end - it > step) ? it + step : end;
+		step *= 2;
+	}
+
+	return lower_bound(low, it, id,
+	[] (const pair<int, float> &e, int id) {
+		return e.first < id;
+	});
+}
+
+
+
 /**
 * @brief Intersect 2 contexts
 *
+* Merge-join of the sorted entries, galloping in the larger context.
+*
 * @param C1 One of the 2 contexts
 * @param C2 One of the 2 contexts
-*
-* @return A pair of vectors containing values of matching keys
+* @param f called with the frequencies of each type found in both contexts,
+* the one of C1 first
 */
-pair<vector<float>, vector<float> >
-ScoreCalculator::IntersectContexts(Context &C1, Context &C2)
+template <class C, class F>
+static inline void intersectContexts(const C &C1, const C &C2, F f)
 {
-	vector<float> v1;
-	vector<float> v2;
+	bool swapped = C1.size() > C2.size();
+	const C &small = swapped ? C2 : C1;
+	const C &large = swapped ? C1 : C2;
+	const pair<int, float> *it = large.begin;
+	const pair<int, float> *end = large.end;
+
+	for (const pair<int, float> *e = small.begin; e != small.end; ++e) {
+		it = gallop(it, end, e->first);
+
+		if (it == end) {
+			return;
+		}
 
-	for (pair<const string, float> &wf : C1) {
-		auto it = C2.find(wf.first);
+		if (it->first == e->first) {
+			if (swapped) {
+				f(it->second, e->second);
+			} else {
+				f(e->second, it->second);
+			}
 
-		if (it != C2.end()) {
-			v1.push_back(wf.second);
-			v2.push_back(it->second);
+			++it;
 		}
 	}
+}
+
 
-	return make_pair(v1, v2);
+
+/**
+* @brief Find the frequency of a type in a context
+*
+* @param begin first entry of the context
+* @param end end of the context
+* @param id type id
+*
+* @return the frequency, or 0 if the type is not in the context
+*/
+static inline float findInContext(const pair<int, float> *begin,
+								  const pair<int, float> *end, int id)
+{
+	const pair<int, float> *it = gallop(begin, end, id);
+	return (it != end && it->first == id) ? it->second : 0.0;
 }
 
 
@@ -68,16 +135,18 @@ ScoreCalculator::IntersectContexts(Context &C1, Context &C2)
 *
 * @return cos(C1, C2) = C1.C2 / (||C1||*||C2||)
 */
-float ScoreCalculator::ccosBool (Context &C1, Context &C2)
+float ScoreCalculator::ccosBool(const SparseContext &C1,
+								const SparseContext &C2)
 {
-	pair<vector<float>, vector<float> > i = IntersectContexts(C1, C2);
-	float product = (float) i.first.size();
+	int n = 0;
+	intersectContexts(C1, C2, [&] (float, float) {
+		++n;
+	});
+	float product = (float) n;
 	if (product == 0){
 		return 0;
 	} else {
-		float normx = sqrt(C1.size());
-		float normy = sqrt(C2.size());
-		return product / (normx * normy);
+		return product / (C1.boolNorm * C2.boolNorm);
 	}
 };
 
@@ -92,271 +161,810 @@ float ScoreCalculator::ccosBool (Context &C1, Context &C2)
 * @param C1 One of the 2 contexts
 * @param C2 One of the 2 contexts
 *
-* @return dice(C1, C2) = 2*C1.C2 / (||C1||^2 + ||C2||^2)
+* @return dice(C1, C2) = 2*C1.C2 / (||C1||^2 + ||C2||^2)
+*/
+float ScoreCalculator::cdiceTF(const SparseContext &C1,
+							   const SparseContext &C2)
+{
+	double product = 0.0;
+	double sq_normx = 0.0;
+	double sq_normy = 0.0;
+	intersectContexts(C1, C2, [&] (float x, float y) {
+		product += x * y;
+		sq_normx += x * x;
+		sq_normy += y * y;
+	});
+	if ((float) product == 0){
+		return 0;
+	} else {
+		return 2 * (float) product /
+			   ((float) sq_normx + (float) sq_normy + this->smoothingParam);
+	}
+};
+
+
+
+
+/**
+* @brief Compute the values derived from a contingency table
+*
+* @param a f(xy)
+* @param b f(x~y)
+* @param c f(~xy)
+* @param d f(~x~y)
+* @param smoothingParam value added to each cell to get the smoothed values
+* @param needs TableNeeds flags of the values to compute besides a, b, c, d
+*
+* @return the values used by the association measures
+*/
+static inline ScoreCalculator::TableValues tableValues(float a, float b,
+		float c, float d, float smoothingParam, int needs)
+{
+	ScoreCalculator::TableValues v = ScoreCalculator::TableValues();
+	v.a = a;
+	v.b = b;
+	v.c = c;
+	v.d = d;
+
+	if (needs & ScoreCalculator::NEEDS_SMOOTHED) {
+		v.sa = a + smoothingParam;
+		v.sb = b + smoothingParam;
+		v.sc = c + smoothingParam;
+		v.sd = d + smoothingParam;
+	}
+
+	if (needs & ScoreCalculator::NEEDS_PROBABILITIES) {
+		v.N = a + b + c + d; // should always keep the same value
+		v.p_xy = a / v.N;
+		v.p_x_star = (a + b) / v.N;
+		v.p_star_y = (a + c) / v.N;
+	}
+
+	return v;
+}
+
+
+
+static inline float minValue(float a, float b)
+{
+	return (a < b) ? a : b;
+}
+
+
+
+static inline float maxValue(float a, float b)
+{
+	return (a > b) ? a : b;
+}
+
+
+
+/*
+* Association measures computed from the contingency table only. They are
+* shared by compute() and computeBatch().
+*
+* Guidelines to define scores :
+* - when b or c divide a number, they should be smoothed (sb, sc)
+* - when using a function such as std::inner_product or std::accumulate
+* where you have to input initial value, be careful to input a float value
+*/
+static inline float jointProbability(const ScoreCalculator::TableValues &v)
+{
+	return v.p_xy;
+}
+
+static inline float conditionalProbabilityX(const ScoreCalculator::TableValues &v)
+{
+	return v.p_xy / v.p_x_star;
+}
+
+static inline float conditionalProbabilityY(const ScoreCalculator::TableValues &v)
+{
+	return v.p_xy / v.p_star_y;
+}
+
+static inline float pointwiseMutualInformation(const ScoreCalculator::TableValues &v)
+{
+	return log2(v.p_xy / v.p_x_star * v.p_star_y);
+}
+
+static inline float mutualDependency(const ScoreCalculator::TableValues &v)
+{
+	return log2(pow(v.p_xy, 2) / v.p_x_star * v.p_star_y);
+}
+
+static inline float logFrequencyBiasedMD(const ScoreCalculator::TableValues &v)
+{
+	return log2(pow(v.p_xy, 2) / (v.p_x_star * v.p_star_y)) +
+		   log2(v.p_xy);
+}
+
+static inline float normalizedExpectation(const ScoreCalculator::TableValues &v)
+{
+	return 2 * v.a / (v.sb + v.sc);
+}
+
+static inline float mutualExpectation(const ScoreCalculator::TableValues &v)
+{
+	return 2 * v.sa * v.p_xy / (v.sb + v.sc);
+}
+
+static inline float salience(const ScoreCalculator::TableValues &v)
+{
+	return log2(pow(v.p_xy, 2) / v.p_x_star * v.p_star_y) * log2(v.a);
+}
+
+static inline float russelRao(const ScoreCalculator::TableValues &v)
+{
+	return v.a / (v.a + v.b + v.c + v.d);
+}
+
+static inline float sokalMichiner(const ScoreCalculator::TableValues &v)
+{
+	return (v.a + v.d) / (v.a + v.b + v.c + v.d);
+}
+
+static inline float rogersTanimoto(const ScoreCalculator::TableValues &v)
+{
+	return (v.a + v.d) / (v.a + 2 * v.b + 2 * v.c + v.d);
+}
+
+static inline float hamann(const ScoreCalculator::TableValues &v)
+{
+	return (v.a + v.d) - (v.b + v.c) / (v.a + v.b + v.c + v.d);
+}
+
+static inline float thirdSokalSneath(const ScoreCalculator::TableValues &v)
+{
+	return (v.b + v.c) / (v.a + v.d);
+}
+
+static inline float jaccard(const ScoreCalculator::TableValues &v)
+{
+	return (v.a) / (v.a + v.b + v.c);
+}
+
+static inline float firstKulczynsky(const ScoreCalculator::TableValues &v)
+{
+	return v.sa / (v.sb + v.sc);
+}
+
+static inline float secondSokalSneath(const ScoreCalculator::TableValues &v)
+{
+	return v.a / (v.a + 2 * (v.b + v.c));
+}
+
+static inline float secondKulczynski(const ScoreCalculator::TableValues &v)
+{
+	return 0.5 * (v.a / (v.a + v.b) + v.a / (v.a + v.c));
+}
+
+static inline float fourthSokalSneath(const ScoreCalculator::TableValues &v)
+{
+	return 0.25 * (v.a / (v.a + v.b) + v.a / (v.a + v.c) +
+				   v.d / (v.d + v.b) + v.d / (v.d + v.c));
+}
+
+static inline float oddsRatio(const ScoreCalculator::TableValues &v)
+{
+	return v.sa * v.sd / (v.sb * v.sc);
+}
+
+static inline float yulleOmega(const ScoreCalculator::TableValues &v)
+{
+	return (sqrt(v.sa * v.sd) - sqrt(v.sb * v.sc)) /
+		   (sqrt(v.sa * v.sd) + sqrt(v.sb * v.sc));
+}
+
+static inline float yulleQ(const ScoreCalculator::TableValues &v)
+{
+	return (v.a * v.d - v.b * v.c) / (v.a * v.d + v.b * v.c);
+}
+
+static inline float driverKroeber(const ScoreCalculator::TableValues &v)
+{
+	return v.a / (sqrt((v.a + v.b) * (v.a + v.c)));
+}
+
+static inline float fifthSokalSneath(const ScoreCalculator::TableValues &v)
+{
+	return v.a * v.d / sqrt((v.a + v.b) * (v.a + v.c) * (v.d + v.b) * (v.d + v.c));
+}
+
+static inline float pearson(const ScoreCalculator::TableValues &v)
+{
+	return (v.a * v.d - v.b * v.c) /
+		   sqrt((v.a + v.b) * (v.a + v.c) * (v.d + v.b) * (v.d + v.c));
+}
+
+static inline float baroniUrbani(const ScoreCalculator::TableValues &v)
+{
+	float s = sqrt(v.a * v.d);
+	return (v.a + s) / (v.a + v.b + v.c + s);
+}
+
+static inline float braunBlanquet(const ScoreCalculator::TableValues &v)
+{
+	return v.a / maxValue(v.a + v.b, v.a + v.c);
+}
+
+static inline float simpson(const ScoreCalculator::TableValues &v)
+{
+	return v.a / minValue(v.a + v.b, v.a + v.c);
+}
+
+static inline float michael(const ScoreCalculator::TableValues &v)
+{
+	return 4 * (v.a * v.d - v.b * v.c) /
+		   (pow(v.a + v.d, 2) + pow(v.b + v.c, 2));
+}
+
+static inline float mountford(const ScoreCalculator::TableValues &v)
+{
+	return 2 * v.a / (2 * v.b * v.c + v.a * v.b + v.a * v.c);
+}
+
+static inline float fager(const ScoreCalculator::TableValues &v)
+{
+	return (v.a / (sqrt((v.a + v.b) * (v.a + v.c)))) - 0.5 * maxValue(v.b, v.c);
+}
+
+static inline float unigramSubtules(const ScoreCalculator::TableValues &v)
+{
+	return log2((v.sa * v.sd) / (v.sb * v.sc)) -
+		   3.29 * sqrt(1 / v.sa + 1 / v.sb + 1 / v.sc + 1 / v.sd);
+}
+
+static inline float uCost(const ScoreCalculator::TableValues &v)
+{
+	return log2(1 + (minValue(v.b, v.c) + v.a) / (maxValue(v.b, v.c) + v.a));
+}
+
+static inline float sCost(const ScoreCalculator::TableValues &v)
+{
+	return pow(log2(1 + (minValue(v.sb, v.sc) / (v.sa + 1))), -0.5);
+}
+
+static inline float rCost(const ScoreCalculator::TableValues &v)
+{
+	return log2(1 + v.a / (v.a + v.b)) * log2(1 + v.a / (v.a + v.c));
+}
+
+static inline float tCombinedCost(const ScoreCalculator::TableValues &v)
+{
+	return sqrt(uCost(v) * sCost(v) * rCost(v));
+}
+
+static inline float phi(const ScoreCalculator::TableValues &v)
+{
+	return (v.p_xy - v.p_x_star * v.p_star_y) /
+		   sqrt(v.p_x_star * v.p_star_y * (1 - v.p_x_star) * (1 - v.p_star_y));
+}
+
+static inline float nullScore(const ScoreCalculator::TableValues &)
+{
+	return 0.0;
+}
+
+
+
+/**
+* @brief Apply a measure to every candidate of a batch
+*
+* The measure is a template parameter so that it is inlined in the loop, which
+* can then be vectorized by the compiler when the measure allows it. Only the
+* values the measure needs are computed.
+*
+* @param batch contingency tables
+* @param smoothingParam value of the smoothing parameter
+* @param out batch.size() scores
+*/
+template <float (*F)(const ScoreCalculator::TableValues &), int NEEDS>
+static void tableKernel(const ScoreCalculator::TableBatch &batch,
+						float smoothingParam, float *out)
+{
+	const float *a = batch.a.data();
+	const float *b = batch.b.data();
+	const float *c = batch.c.data();
+	const float *d = batch.d.data();
+	int n = batch.size();
+
+	for (int i = 0; i < n; ++i) {
+		out[i] = F(tableValues(a[i], b[i], c[i], d[i], smoothingParam, NEEDS));
+	}
+}
+
+
+
+/**
+* @brief Entry of the registry of the measures computed from the table only
+*/
+struct TableMeasure {
+	int id; // number of the score
+	int needs; // TableNeeds flags
+	ScoreCalculator::TableScore score;
+	ScoreCalculator::Kernel kernel;
+};
+
+
+
+template <float (*F)(const ScoreCalculator::TableValues &), int NEEDS>
+constexpr TableMeasure tableMeasure(int id)
+{
+	return TableMeasure {id, NEEDS, F, &tableKernel<F, NEEDS>};
+}
+
+
+
+#define SMOOTHED ScoreCalculator::NEEDS_SMOOTHED
+#define PROBABILITIES ScoreCalculator::NEEDS_PROBABILITIES
+#define COUNTS ScoreCalculator::NEEDS_COUNTS
+
+static constexpr TableMeasure tableMeasures[] = {
+	tableMeasure<jointProbability, PROBABILITIES>(1),
+	tableMeasure<conditionalProbabilityX, PROBABILITIES>(2),
+	tableMeasure<conditionalProbabilityY, PROBABILITIES>(3),
+	tableMeasure<pointwiseMutualInformation, PROBABILITIES>(4),
+	tableMeasure<mutualDependency, PROBABILITIES>(5),
+	tableMeasure<logFrequencyBiasedMD, PROBABILITIES>(6),
+	tableMeasure<normalizedExpectation, SMOOTHED>(7),
+	tableMeasure<mutualExpectation, SMOOTHED | PROBABILITIES>(8),
+	tableMeasure<salience, PROBABILITIES>(9),
+	tableMeasure<russelRao, COUNTS>(17),
+	tableMeasure<sokalMichiner, COUNTS>(18),
+	tableMeasure<rogersTanimoto, COUNTS>(19),
+	tableMeasure<hamann, COUNTS>(20),
+	tableMeasure<thirdSokalSneath, COUNTS>(21),
+	tableMeasure<jaccard, COUNTS>(22),
+	tableMeasure<firstKulczynsky, SMOOTHED>(23),
+	tableMeasure<secondSokalSneath, COUNTS>(24),
+	tableMeasure<secondKulczynski, COUNTS>(25),
+	tableMeasure<fourthSokalSneath, COUNTS>(26),
+	tableMeasure<oddsRatio, SMOOTHED>(27),
+	tableMeasure<yulleOmega, SMOOTHED>(28),
+	tableMeasure<yulleQ, COUNTS>(29),
+	tableMeasure<driverKroeber, COUNTS>(30),
+	tableMeasure<fifthSokalSneath, COUNTS>(31),
+	tableMeasure<pearson, COUNTS>(32),
+	tableMeasure<baroniUrbani, COUNTS>(33),
+	tableMeasure<braunBlanquet, COUNTS>(34),
+	tableMeasure<simpson, COUNTS>(35),
+	tableMeasure<michael, COUNTS>(36),
+	tableMeasure<mountford, COUNTS>(37),
+	tableMeasure<fager, COUNTS>(38),
+	tableMeasure<unigramSubtules, SMOOTHED>(39),
+	tableMeasure<uCost, COUNTS>(40),
+	tableMeasure<sCost, SMOOTHED>(41),
+	tableMeasure<rCost, COUNTS>(42),
+	tableMeasure<tCombinedCost, SMOOTHED>(43),
+	tableMeasure<phi, PROBABILITIES>(44)
+};
+
+#undef SMOOTHED
+#undef PROBABILITIES
+#undef COUNTS
+
+
+
+/*
+* Association measures of n-grams, computed from the whole 2^n contingency
+* table. For n = 2, they match the usual definitions.
+*/
+static inline float ngramPMI(const ScoreCalculator::NgramValues &v)
+{
+	// log2(p(w_1...w_n) / (p(w_1) * ... * p(w_n)))
+	double expected = v.N;
+
+	for (int i = 0; i < v.n; ++i) {
+		expected *= v.marginals[i] / v.N;
+	}
+
+	return log2(v.a / expected);
+}
+
+static inline float ngramLogLikelihood(const ScoreCalculator::NgramValues &v)
+{
+	// G2 = 2 * sum(O * ln(O / E)) over the cells, E under independence
+	double sum = 0.0;
+
+	for (int m = 0; m < (1 << v.n); ++m) {
+		if (v.observed[m] <= 0) {
+			continue;
+		}
+
+		double expected = v.N;
+
+		for (int i = 0; i < v.n; ++i) {
+			double p = v.marginals[i] / v.N;
+			expected *= ((m >> i) & 1) ? p : 1 - p;
+		}
+
+		sum += v.observed[m] * log(v.observed[m] / expected);
+	}
+
+	return 2 * sum;
+}
+
+static inline float ngramDice(const ScoreCalculator::NgramValues &v)
+{
+	// n * f(w_1...w_n) / (f(w_1) + ... + f(w_n))
+	double sum = 0.0;
+
+	for (int i = 0; i < v.n; ++i) {
+		sum += v.marginals[i];
+	}
+
+	return v.n * v.a / sum;
+}
+
+static inline float ngramFairDice(const ScoreCalculator::NgramValues &v)
+{
+	// Dice with fair dispersion point normalization : average over the
+	// splits of the n-gram in 2 parts
+	double sum = 0.0;
+
+	for (int i = 1; i < v.n; ++i) {
+		sum += v.prefixes[i] + v.suffixes[i];
+	}
+
+	return 2 * v.a / (sum / (v.n - 1));
+}
+
+
+
+/**
+* @brief Entry of the registry of the measures of n-grams
+*/
+struct NgramMeasure {
+	int id; // number of the score
+	ScoreCalculator::NgramScore score;
+};
+
+
+
+static constexpr NgramMeasure ngramMeasures[] = {
+	{101, ngramPMI},
+	{102, ngramLogLikelihood},
+	{103, ngramDice},
+	{104, ngramFairDice}
+};
+
+
+
+/**
+* @brief Define the measures using contexts
+*
+* They are bound to this calculator's contexts.
+*/
+void ScoreCalculator::defineContextScores()
+{
+	if (hasImmediateContext) {
+		immediateContexts.resize(2);
+		const Context &cl = immediateContexts[LEFT];
+		const Context &cr = immediateContexts[RIGHT];
+		auto diff_product_log = [] (float x, pair<string, float> y, float contextSize) {
+			float p = y.second / contextSize;
+			return x - p * log2(p);
+		};
+		scores[57] = [&] () { // left context entropy
+			return accumulate(cl.begin(), cl.end(), 0.0,
+							  bind(diff_product_log, _1, _2, cl.size()));
+		};
+		scores[58] = [&] () { // right context entropy
+			return accumulate(cr.begin(), cr.end(), 0.0,
+							  bind(diff_product_log, _1, _2, cr.size()));
+		};
+		scores[59] = [&] () { // left context divergence
+			return accumulate(cl.begin(), cl.end(), v.p_x_star * log2(v.p_x_star),
+							  bind(diff_product_log, _1, _2, cl.size()));
+		};
+		scores[60] = [&] () { // right context divergence
+			return accumulate(cr.begin(), cr.end(), v.p_star_y * log2(v.p_star_y),
+							  bind(diff_product_log, _1, _2, cr.size()));
+		};
+	}
+
+	if (hasBroadContext) {
+		scores[62] = [&] () { // Reverse cross entropy
+			float sum = 0.0;
+			const pair<int, float> *x = Cx.begin;
+
+			for (const pair<int, float> *wf = Cy.begin; wf != Cy.end; ++wf) {
+				x = gallop(x, Cx.end, wf->first);
+				float p = (x != Cx.end && x->first == wf->first) ? x->second : 0.0;
+				sum = sum + (wf->second / Cy.size()) *
+					  log2((p + this->smoothingParam) / Cx.size());
+			}
+
+			return - sum;
+		};
+		scores[68] = [&] () { // Reverse confusion probability
+			int t1 = typesCandidates[0];
+			int t2 = typesCandidates[1];
+			// p(x|Cz)*p(y|Cz)*p(z)
+			// The broad context contains all the types which have contexts that
+			// contains the types of the candidates... The z are the types of
+			// the postings of both x and y found in the broad context, and the
+			// weights of the postings are p(x|Cz) and p(y|Cz)
+			float sum = 0.0;
+			const pair<int, float> *p1 = store->postingsBegin(t1);
+			const pair<int, float> *end1 = store->postingsEnd(t1);
+			const pair<int, float> *p2 = store->postingsBegin(t2);
+			const pair<int, float> *end2 = store->postingsEnd(t2);
+			const pair<int, float> *wf = broadContext.begin;
+
+			while (p1 != end1 && p2 != end2) {
+				if (p1->first < p2->first) {
+					p1 = gallop(p1, end1, p2->first);
+				} else if (p2->first < p1->first) {
+					p2 = gallop(p2, end2, p1->first);
+				} else {
+					wf = gallop(wf, broadContext.end, p1->first);
+
+					if (wf == broadContext.end) {
+						break;
+					}
+
+					if (wf->first == p1->first) {
+						sum = sum + p1->second * p2->second * wf->second;
+					}
+
+					++p1;
+					++p2;
+				}
+			}
+
+			return sum / v.p_star_y;
+		};
+		scores[75] = [&] () { // Phrase word coocurrence
+			float f_x_cxy = findInContext(broadContext.begin, broadContext.end,
+										  typesCandidates[0]);
+			float f_y_cxy = findInContext(broadContext.begin, broadContext.end,
+										  typesCandidates[1]);
+			return 0.5 * ((f_x_cxy / v.a) +  (f_y_cxy / v.a));
+		};
+		scores[77] = [&] () {
+			SparseContext &Cxy = broadContext;
+			return 0.5 * (ccosBool(Cx, Cxy) + ccosBool(Cy, Cxy));
+		};
+		scores[81] = [&] () {
+			SparseContext &Cxy = broadContext;
+			return 0.5 * (cdiceTF(Cx, Cxy) + cdiceTF(Cy, Cxy));
+		};
+	}
+}
+
+
+
+/**
+* @brief Contains the association measures
+*
+* The measures computed from the contingency table only are in the
+* tableMeasures registry, the measures using contexts are defined here.
+*
+* @param immediate true if immediate context will be given
+* @param broad true if broad context will be given
+* @param toCompute vector of scores to compute
+* @param smoothingParam value of the smoothing parameter
+*/
+ScoreCalculator::ScoreCalculator(bool immediate, bool broad,
+								 vector<int> toCompute, float smoothingParam) :
+	hasImmediateContext(immediate),
+	hasBroadContext(broad),
+	scoresToCompute(toCompute),
+	smoothingParam(smoothingParam),
+	needs(NEEDS_COUNTS),
+	typeIds(new TypeIds()),
+	store(new UnigramStore()),
+	ownsStore(true),
+	usesIndex(find(toCompute.begin(), toCompute.end(), 68) != toCompute.end()),
+	cache(0),
+	cachedSlot(-1)
+{
+	newCandidate();
+
+	defineContextScores();
+
+	for (int n = 0; n <= 4; ++n) {
+		cellMasks.push_back(ContextCandidate::contingencyOrder(n));
+	}
+
+	for (int i : scoresToCompute) {
+		const TableMeasure *m = 0;
+		NgramScore ngramScore = 0;
+
+		for (const TableMeasure &t : tableMeasures) {
+			if (t.id == i) {
+				m = &t;
+			}
+		}
+
+		for (const NgramMeasure &t : ngramMeasures) {
+			if (t.id == i) {
+				ngramScore = t.score;
+			}
+		}
+
+		if (m == 0 && ngramScore == 0 && scores.find(i) == scores.end()) {
+			cerr << "Error: Function " << i << " not defined. ";
+			cerr << "Replaced by null function." << endl;
+			static constexpr TableMeasure null = tableMeasure<nullScore,
+				   NEEDS_COUNTS>(0);
+			m = &null;
+		}
+
+		if (m != 0) {
+			needs |= m->needs;
+			tableScores.push_back(m->score);
+			kernels.push_back(m->kernel);
+			ngramScores.push_back(0);
+			contextScores.push_back(Score());
+		} else if (ngramScore != 0) {
+			needs |= NEEDS_NGRAM;
+			tableScores.push_back(0);
+			kernels.push_back(0);
+			ngramScores.push_back(ngramScore);
+			contextScores.push_back(Score());
+		} else {
+			// context measures may use any value of the 2-gram table
+			needs |= NEEDS_SMOOTHED | NEEDS_PROBABILITIES;
+			tableScores.push_back(0);
+			kernels.push_back(0);
+			ngramScores.push_back(0);
+			contextScores.push_back(scores[i]);
+		}
+	}
+}
+
+
+
+/**
+* @brief Copy a calculator to score candidates in another thread
+*
+* The copy has its own contexts but shares the types entered in model with
+* addType(), and the ids of their names, which must not change while the
+* copy is used.
+*
+* @param model calculator to copy
+*/
+ScoreCalculator::ScoreCalculator(const ScoreCalculator &model) :
+	hasImmediateContext(model.hasImmediateContext),
+	hasBroadContext(model.hasBroadContext),
+	scoresToCompute(model.scoresToCompute),
+	smoothingParam(model.smoothingParam),
+	needs(model.needs),
+	tableScores(model.tableScores),
+	kernels(model.kernels),
+	ngramScores(model.ngramScores),
+	cellMasks(model.cellMasks),
+	typeIds(model.typeIds),
+	store(model.store),
+	ownsStore(false),
+	usesIndex(model.usesIndex),
+	cache(0),
+	cachedSlot(-1)
+{
+	newCandidate();
+	defineContextScores();
+
+	// built here rather than by the copies scoring in parallel
+	if (usesIndex && !store->isIndexed()) {
+		store->buildIndex();
+	}
+
+	for (int i = 0; i < (int) scoresToCompute.size(); ++i) {
+		if (tableScores[i] != 0 || ngramScores[i] != 0) {
+			contextScores.push_back(Score());
+		} else {
+			contextScores.push_back(scores[scoresToCompute[i]]);
+		}
+	}
+}
+
+
+
+ScoreCalculator::~ScoreCalculator()
+{
+	delete cache;
+
+	if (ownsStore) {
+		delete store;
+	}
+}
+
+
+
+/**
+* @brief Get the id of a type name, giving a new id to unknown names
+*
+* @param name string format of the type
+*
+* @return id of the type
 */
-float ScoreCalculator::cdiceTF (Context &C1, Context &C2)
+int ScoreCalculator::internType(const string &name)
 {
-	pair<vector<float>, vector<float> > i = IntersectContexts(C1, C2);
-	float product = std::inner_product(i.first.begin(), i.first.end(),
-									   i.second.begin(), 0.0);
-	if (product == 0){
-		return 0;
-	} else {
-		float sq_normx = std::inner_product(i.first.begin(), i.first.end(),
-											i.first.begin(), 0.0);
-		float sq_normy = std::inner_product(i.second.begin(), i.second.end(),
-											i.second.begin(), 0.0);
-		return 2 * product / (sq_normx + sq_normy + this->smoothingParam);
+	auto it = typeIds->find(name);
+
+	if (it != typeIds->end()) {
+		return it->second;
+	}
+
+	if (ownsStore) {
+		int id = typeIds->size();
+		(*typeIds)[name] = id;
+		return id;
+	}
+
+	// a copy : the ids of the model are followed by the names of the copy
+	it = newTypeIds.find(name);
+
+	if (it != newTypeIds.end()) {
+		return it->second;
 	}
-};
 
+	int id = typeIds->size() + newTypeIds.size();
+	newTypeIds[name] = id;
+	return id;
+}
 
 
 
 /**
-* @brief Contains the association measures
+* @brief Fill a context with names and frequencies
 *
-* Guidelines to define scores :
-* - when b or c divide a number, they should be smoothed (sb, sc)
-* - when using a function such as std::inner_product or std::accumulate
-* where you have to input initial value, be careful to input a float value
+* Names are interned and entries sorted by type id. When a name is given
+* several times, the last frequency is kept.
 *
-* @param immediate true if immediate context will be given
-* @param broad true if broad context will be given
-* @param toCompute vector of scores to compute
-* @param smoothingParam value of the smoothing parameter
+* @param entries the entries to fill, previous entries are removed
+* @param names string format of the types
+* @param freqs matching frequencies
 */
-ScoreCalculator::ScoreCalculator(bool immediate, bool broad,
-								 vector<int> toCompute, float smoothingParam) :
-	hasImmediateContext(immediate),
-	hasBroadContext(broad),
-	scoresToCompute(toCompute),
-	smoothingParam(smoothingParam)
-{
-	auto min = [] (float a, float b) {
-		return (a < b) ? a : b;
-	};
-	auto max = [] (float a, float b) {
-		return (a > b) ? a : b;
-	};
-	scores[1] = [&] () { // joint probability
-		return p_xy;
-	};
-	scores[2] = [&] () {
-		return p_xy / p_x_star;
-	};
-	scores[3] = [&] () {
-		return p_xy / p_star_y;
-	};
-	scores[4] = [&] () { // pointwise mutual information
-		return log2(p_xy / p_x_star * p_star_y);
-	};
-	scores[5] = [&] () { // mutual dependency (MD)
-		return log2(pow(p_xy, 2) / p_x_star * p_star_y);
-	};
-	scores[6] = [&] () { // log frequency biased MD
-		return log2(pow(p_xy, 2) / (p_x_star * p_star_y)) +
-			   log2(p_xy);
-	};
-	scores[7] = [&] () { // normalized expectation
-		return 2 * a / (sb + sc);
-	};
-	scores[8] = [&] () { // mutual expectation
-		return 2 * sa * p_xy / (sb + sc);
-	};
-	scores[9] = [&] () { // salience
-		return log2(pow(p_xy, 2) / p_x_star * p_star_y) * log2(a);
-	};
-	scores[17] = [&] () { // Russel-Rao
-		return a / (a + b + c + d);
-	};
-	scores[18] = [&] () { // Sokal-Michiner
-		return (a + d) / (a + b + c + d);
-	};
-	scores[19] = [&] () { // Rogers-Tanimoto
-		return (a + d) / (a + 2 * b + 2 * c + d);
-	};
-	scores[20] = [&] () { // Hamann
-		return (a + d) - (b + c) / (a + b + c + d);
-	};
-	scores[21] = [&] () { // Third Sokal-Sneath
-		return (b + c) / (a + d);
-	};
-	scores[22] = [&] () { // Jaccard
-		return (a) / (a + b + c);
-	};
-	scores[23] = [&] () {
-		return sa / (sb + sc); // First Kulczynsky
-	};
-	scores[24] = [&] () { // Second Sokal-Sneath
-		return a / (a + 2 * (b + c));
-	};
-	scores[25] = [&] () { // Second Kulczynski
-		return 0.5 * (a / (a + b) + a / (a + c));
-	};
-	scores[26] = [&] () { // Fourth Sokal-Sneath
-		return 0.25 * (a / (a + b) + a / (a + c) + d / (d + b) + d / (d + c));
-	};
-	scores[27] = [&] () { // Odds ratio
-		return sa * sd / (sb * sc);
-	};
-	scores[28] = [&] () { // Yulle's omega
-		return (sqrt(sa * sd) - sqrt(sb * sc)) / (sqrt(sa * sd) + sqrt(sb * sc));
-	};
-	scores[29] = [&] () { // Yulle's Q
-		return (a * d - b * c) / (a * d + b * c);
-	};
-	scores[30] = [&] () { // Driver-Kroeber
-		return a / (sqrt((a + b) * (a + c)));
-	};
-	scores[31] = [&] () { // Fifth Sokal-Sneath
-		return a * d / sqrt((a + b) * (a + c) * (d + b) * (d + c));
-	};
-	scores[32] = [&] () { // Pearson
-		return (a * d - b * c) / sqrt((a + b) * (a + c) * (d + b) * (d + c));
-	};
-	scores[33] = [&] () { // Baroni-Urbani
-		float s = sqrt(a * d);
-		return (a + s) / (a + b + c + s);
-	};
-	scores[34] = [&] () { // Braun-Blanquet
-		return a / max(a + b, a + c);
-	};
-	scores[35] = [&] () { // Simpson
-		return a / min(a + b, a + c);
-	};
-	scores[36] = [&] () { // Michael
-		return 4 * (a * d - b * c) / (pow(a + d, 2) + pow(b + c, 2));
-	};
-	scores[37] = [&] () { // Mountford
-		return 2 * a / (2 * b * c + a * b + a * c);
-	};
-	scores[38] = [&] () { // Fager
-		return (a / (sqrt((a + b) * (a + c)))) - 0.5 * max(b, c);
-	};
-	scores[39] = [&] () { // Unigram subtules
-		return log2((sa * sd) / (sb * sc)) -
-			   3.29 * sqrt(1 / sa + 1 / sb + 1 / sc + 1 / sd);
-	};
-	scores[40] = [&] () { // U cost
-		return log2(1 + (min(b, c) + a) / (max(b, c) + a));
-	};
-	scores[41] = [&] () { // S cost
-		return pow(log2(1 + (min(sb, sc) / (sa + 1))), -0.5);
-	};
-	scores[42] = [&] () { // R cost
-		return log2(1 + a / (a + b)) * log2(1 + a / (a + c));
-	};
-	scores[43] = [&] () { // T combined cost
-		return sqrt(scores[40]() * scores[41]() * scores[42]());
-	};
-	scores[44] = [&] () { // Phi
-		return (p_xy - p_x_star * p_star_y) /
-			   sqrt(p_x_star * p_star_y * (1 - p_x_star) * (1 - p_star_y));
-	};
+void ScoreCalculator::fillContext(vector<UnigramStore::Entry> &entries,
+								  const vector<string> &names,
+								  const vector<int> &freqs)
+{
+	entries.clear();
+	entries.reserve(names.size());
 
-	if (hasImmediateContext) {
-		immediateContexts.resize(2);
-		const Context &cl = immediateContexts[LEFT];
-		const Context &cr = immediateContexts[RIGHT];
-		auto diff_product_log = [] (float x, pair<string, float> y, float contextSize) {
-			float p = y.second / contextSize;
-			return x - p * log2(p);
-		};
-		scores[57] = [&] () { // left context entropy
-			return accumulate(cl.begin(), cl.end(), 0.0,
-							  bind(diff_product_log, _1, _2, cl.size()));
-		};
-		scores[58] = [&] () { // right context entropy
-			return accumulate(cr.begin(), cr.end(), 0.0,
-							  bind(diff_product_log, _1, _2, cr.size()));
-		};
-		scores[59] = [&] () { // left context divergence
-			return accumulate(cl.begin(), cl.end(), p_x_star * log2(p_x_star),
-							  bind(diff_product_log, _1, _2, cl.size()));
-		};
-		scores[60] = [&] () { // right context divergence
-			return accumulate(cr.begin(), cr.end(), p_star_y * log2(p_star_y),
-							  bind(diff_product_log, _1, _2, cr.size()));
-		};
+	for (int i = 0; i < (int) names.size(); ++i) {
+		entries.push_back(make_pair(internType(names[i]), (float) freqs[i]));
 	}
 
-	if (hasBroadContext) {
-		scores[62] = [&] () { // Reverse cross entropy
-			auto l = [&] (float sum, pair<string, float> wf) {
-				auto it = Cx->find(wf.first);
-				float p = 0.0;
-
-				if (it != Cx->end()) {
-					p = it->second;
-				}
+	stable_sort(entries.begin(), entries.end(),
+	[] (const pair<int, float> &e1, const pair<int, float> &e2) {
+		return e1.first < e2.first;
+	});
+	// keep the last of equal ids
+	auto last = unique(entries.rbegin(), entries.rend(),
+	[] (const pair<int, float> &e1, const pair<int, float> &e2) {
+		return e1.first == e2.first;
+	});
+	entries.erase(entries.begin(), last.base());
+}
 
-				return sum + (wf.second / Cy->size()) *
-					   log2((p + this->smoothingParam) / Cx->size());
-			};
-			return - accumulate(Cy->begin(), Cy->end(), 0.0, l);
-		};
-		scores[68] = [&] () { // Reverse confusion probability
-			const string &t1 = typesCandidates[0].first;
-			const string &t2 = typesCandidates[1].first;
-			// p(x|Cz)*p(y|Cz)*p(z)
-			// The broad context contains all the types which have contexts that
-			// contains the types of the candidates...
-			auto context_product = [&] (float sum, pair<string, float> wf) {
-				Context &c = types[wf.first]->context;
-				auto it1 = c.find(t1);
-				auto it2 = c.find(t2);
-
-				if (it1 == c.end() || it2 == c.end()) {
-					// here, we didn't find a type in its own context...
-					return sum;
-				}
 
-				// c.size() not null because we found t1 & t2
-				return sum + (it1->second / c.size()) * (it2->second / c.size()) * wf.second;
-			};
-			return accumulate(broadContext.begin(), broadContext.end(),
-							  0.0, context_product) / p_star_y;
-		};
-		scores[75] = [&] () { // Phrase word coocurrence
-			auto occur0 = broadContext.find(typesCandidates[0].first);
-			auto occur1 = broadContext.find(typesCandidates[1].first);
-			float f_x_cxy = (occur0 != broadContext.end()) ? occur0->second : 0.0;
-			float f_y_cxy = (occur1 != broadContext.end()) ? occur1->second : 0.0;
-			return 0.5 * ((f_x_cxy / a) +  (f_y_cxy / a));
-		};
-		scores[77] = [&] () {
-			Context &Cx = typesCandidates[0].second->context;
-			Context &Cy = typesCandidates[1].second->context;
-			Context &Cxy = broadContext;
-			return 0.5 * (ccosBool(Cx, Cxy) + ccosBool(Cy, Cxy));
-		};
-		scores[81] = [&] () {
-			Context &Cx = typesCandidates[0].second->context;
-			Context &Cy = typesCandidates[1].second->context;
-			Context &Cxy = broadContext;
-			return 0.5 * (cdiceTF(Cx, Cxy) + cdiceTF(Cy, Cxy));
-		};
-	}
 
-	for (auto & i : scoresToCompute) {
-		if (scores.find(i) == scores.end()) {
-			cerr << "Error: Function " << i << " not defined. ";
-			cerr << "Replaced by null function." << endl;
-			scores[i] = [] () {
-				return 0.0;
-			};
-		}
-	}
+/**
+* @brief Get the context of a type entered with addType()
+*
+* @param id type id
+*
+* @return the context, empty if the type was not added
+*/
+ScoreCalculator::SparseContext ScoreCalculator::contextOf(int id) const
+{
+	SparseContext context;
+	context.begin = store->contextBegin(id);
+	context.end = store->contextEnd(id);
+	context.boolNorm = sqrt(context.size());
+	return context;
 }
 
 
 
-ScoreCalculator::~ScoreCalculator()
+int ScoreCalculator::SparseContext::size() const
 {
-	for (auto & t : types) {
-		delete t.second;
-	}
+	return end - begin;
 }
 
 
@@ -366,7 +974,16 @@ ScoreCalculator::~ScoreCalculator()
 */
 void ScoreCalculator::newCandidate()
 {
-	broadContext.clear();
+	// fresh maps : the order of their iteration, hence the rounding of the
+	// entropies, does not depend on the previous candidates
+	for (Context &c : immediateContexts) {
+		Context().swap(c);
+	}
+
+	broadEntries.clear();
+	broadContext.begin = broadEntries.data();
+	broadContext.end = broadContext.begin;
+	broadContext.boolNorm = 0;
 }
 
 
@@ -386,16 +1003,20 @@ void ScoreCalculator::newCandidate(vector<string> wordTypes)
 	for (int i = 0; i < (int) wordTypes.size(); ++i) {
 		// if the file is well formed and contained all word types first
 		// the types contained in candidates will for sure be found
-		typesCandidates[i] = pair<string, WordTypeSimplified *>(
-								 wordTypes[i], types[wordTypes[i]]);
+		int id = internType(wordTypes[i]);
+		typesCandidates[i] = id;
 
-		if (types[wordTypes[i]] == 0) {
+		if (!store->contains(id)) {
 			cout << "Error: Wordtype " << wordTypes[i] << " not found" << endl;
 		}
 	}
 
-	Cx = &(typesCandidates[0].second->context);
-	Cy = &(typesCandidates[1].second->context);
+	Cx = contextOf(typesCandidates[0]);
+	Cy = contextOf(typesCandidates[1]);
+
+	if (usesIndex && !store->isIndexed()) {
+		store->buildIndex();
+	}
 }
 
 
@@ -408,27 +1029,95 @@ void ScoreCalculator::newCandidate(vector<string> wordTypes)
 void ScoreCalculator::addContingencyTable(vector<int> contingencyTable)
 {
 	table.assign(contingencyTable.begin(), contingencyTable.end());
-	a = table[0];
-	b = table[1]; // n = 2
-	c = table[2]; // n = 2
-	d = table[3]; // n = 2
-	N = a + b + c + d; // should always keep the same value
-	auto smoothContingency = [&] (float v){
-		return (v + smoothingParam);
-	};
-	sa = smoothContingency(a);
-	sb = smoothContingency(b);
-	sc = smoothContingency(c);
-	sd = smoothContingency(d);
-
-	if (sb == b || sc == c) {
+
+	if (table[1] + smoothingParam == table[1] ||
+			table[2] + smoothingParam == table[2]) {
 		cout << "Error: smoothing parameter too low : "
 			 << "smoothed value = not smoothed value" << endl;
 	}
 
-	p_xy = a / N;
-	p_x_star = (a + b) / N;
-	p_star_y = (a + c) / N;
+	ScoreCache *c = getCache(table.size());
+	cachedSlot = (c != 0) ? c->find(table.data()) : -1;
+
+	if (cachedSlot >= 0) {
+		return;
+	}
+
+	// n = 2 : only the first 4 values are used
+	v = tableValues(table[0], table[1], table[2], table[3], smoothingParam,
+					needs);
+
+	if (needs & NEEDS_NGRAM) {
+		computeNgramValues();
+	}
+}
+
+
+
+/**
+* @brief Compute the values of the n-gram measures from the whole table
+*
+* The table holds f(w_1...w_n), then f(s) - f(w_1...w_n) for each
+* subcandidate s in the order of ContextCandidate::contingencyOrder(), then N
+* minus the sum of the previous values. The frequencies of the subcandidates
+* give the observed cells by inclusion-exclusion.
+*/
+void ScoreCalculator::computeNgramValues()
+{
+	int size = table.size();
+	int n = 0;
+
+	while ((1 << n) < size) {
+		++n;
+	}
+
+	if ((1 << n) != size || n < 2 || n > 4) {
+		cout << "Error: contingency table of " << size << " values : "
+			 << "n-gram scores need 4, 8 or 16 values" << endl;
+		n = 2;
+	}
+
+	int full = (1 << n) - 1;
+	// f[m] : frequency of the subcandidate where the types of m are undefined
+	double f[16];
+	double N = 0.0;
+
+	for (int i = 0; i <= full; ++i) {
+		N += table[i];
+	}
+
+	f[0] = table[0];
+
+	for (int k = 1; k < full; ++k) {
+		f[cellMasks[n][k - 1]] = table[k] + table[0];
+	}
+
+	f[full] = N;
+	ngram.n = n;
+	ngram.N = N;
+	ngram.a = table[0];
+
+	for (int i = 0; i < n; ++i) {
+		ngram.marginals[i] = f[full & ~(1 << i)];
+		// w_1...w_i : the types from i are undefined
+		ngram.prefixes[i] = f[full & ~((1 << i) - 1)];
+		// w_i+1...w_n : the types before i are undefined
+		ngram.suffixes[i] = f[(1 << i) - 1];
+	}
+
+	// Moebius inversion : observed[m] = sum over m' containing m of
+	// (-1)^|m' - m| * f(types of m' defined)
+	for (int m = 0; m <= full; ++m) {
+		ngram.observed[m] = f[full & ~m];
+	}
+
+	for (int i = 0; i < n; ++i) {
+		for (int m = 0; m <= full; ++m) {
+			if (!((m >> i) & 1)) {
+				ngram.observed[m] -= ngram.observed[m | (1 << i)];
+			}
+		}
+	}
 }
 
 
@@ -460,9 +1149,10 @@ void ScoreCalculator::addToImmediateContext(ContextSide context,
 void ScoreCalculator::addToBroadContext(vector<string> types,
 										vector<int> freqs)
 {
-	for (int i = 0; i < (int) types.size(); ++i) {
-		broadContext[types[i]] = freqs[i];
-	}
+	fillContext(broadEntries, types, freqs);
+	broadContext.begin = broadEntries.data();
+	broadContext.end = broadContext.begin + broadEntries.size();
+	broadContext.boolNorm = sqrt(broadEntries.size());
 }
 
 
@@ -474,12 +1164,207 @@ void ScoreCalculator::addToBroadContext(vector<string> types,
 */
 vector<float> ScoreCalculator::compute()
 {
+	if (cachedSlot >= 0) {
+		const float *scores = cache->getScores(cachedSlot);
+		return vector<float>(scores, scores + scoresToCompute.size());
+	}
+
 	vector<float> res(scoresToCompute.size());
-	int newIndex = 0;
 
-	for (int i : scoresToCompute) {
-		res[newIndex] = scores[i]();
-		++newIndex;
+	for (int i = 0; i < (int) scoresToCompute.size(); ++i) {
+		if (tableScores[i] != 0) {
+			res[i] = tableScores[i](v);
+		} else if (ngramScores[i] != 0) {
+			res[i] = ngramScores[i](ngram);
+		} else {
+			res[i] = contextScores[i]();
+		}
+	}
+
+	ScoreCache *c = getCache(table.size());
+
+	if (c != 0) {
+		c->setScores(c->reserve(table.data()), res.data());
+	}
+
+	return res;
+}
+
+
+
+/**
+* @brief Get the cache of the scores
+*
+* The cache is only used when no score needs contexts. It is created at the
+* first call, for keys of keySize values.
+*
+* @param keySize number of values of the contingency tables
+*
+* @return the cache, or 0 if the scores cannot be cached for such tables
+*/
+ScoreCache *ScoreCalculator::getCache(int keySize)
+{
+	if (cache == 0) {
+		for (const Score &s : contextScores) {
+			if (s) {
+				return 0;
+			}
+		}
+
+		cache = new ScoreCache(keySize, scoresToCompute.size(),
+							   SCORE_CACHE_SLOTS);
+	}
+
+	return (cache->getKeySize() == keySize) ? cache : 0;
+}
+
+
+
+/**
+* @return number of contingency tables looked up in the cache of the scores
+*/
+long long ScoreCalculator::getCacheLookups() const
+{
+	return (cache != 0) ? cache->getLookups() : 0;
+}
+
+
+
+/**
+* @return number of contingency tables whose scores were found in the cache
+*/
+long long ScoreCalculator::getCacheHits() const
+{
+	return (cache != 0) ? cache->getHits() : 0;
+}
+
+
+
+/**
+* @brief Whether computeBatch() can compute all the scores
+*
+* Only the scores which need nothing but the contingency table can be
+* computed by batch.
+*
+* @return true if no requested score needs contexts
+*/
+bool ScoreCalculator::canComputeBatch() const
+{
+	for (Kernel k : kernels) {
+		if (k == 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+
+/**
+* @brief Whether all the scores can be computed for n-grams
+*
+* The other measures are defined for 2-grams : they only use the 4 first
+* values of the table.
+*
+* @return true if all requested scores are measures of n-grams
+*/
+bool ScoreCalculator::onlyNgramScores() const
+{
+	for (int i = 0; i < (int) scoresToCompute.size(); ++i) {
+		if (ngramScores[i] == 0 && tableScores[i] != &nullScore) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+
+/**
+* @brief Compute all scores that were passed to the constructor on a batch
+*
+* Each score is computed for the whole batch at once, instead of each candidate
+* going through all the scores. canComputeBatch() must be true.
+*
+* @param batch contingency tables of the candidates
+*
+* @return one column of batch.size() values per score, in the order given to
+* the constructor
+*/
+vector<vector<float> > ScoreCalculator::computeBatch(const TableBatch &batch)
+{
+	int n = batch.size();
+
+	for (int i = 0; i < n; ++i) {
+		if (batch.b[i] + smoothingParam == batch.b[i] ||
+				batch.c[i] + smoothingParam == batch.c[i]) {
+			cout << "Error: smoothing parameter too low : "
+				 << "smoothed value = not smoothed value" << endl;
+		}
+	}
+
+	int nScores = scoresToCompute.size();
+	vector<vector<float> > res(nScores, vector<float>(n));
+	ScoreCache *c = getCache(4);
+
+	if (c == 0) {
+		for (int k = 0; k < nScores; ++k) {
+			kernels[k](batch, smoothingParam, res[k].data());
+		}
+
+		return res;
+	}
+
+	// Only the tables which are not in the cache are computed, once per
+	// batch : source[i] is the index of the table of candidate i among them
+	TableBatch misses;
+	vector<int> missSlots;
+	vector<int> source(n, -1);
+
+	for (int i = 0; i < n; ++i) {
+		float key[4] = {batch.a[i], batch.b[i], batch.c[i], batch.d[i]};
+		int slot = c->find(key);
+
+		if (slot >= 0 && c->getPending(slot) < 0) {
+			const float *scores = c->getScores(slot);
+
+			for (int k = 0; k < nScores; ++k) {
+				res[k][i] = scores[k];
+			}
+		} else if (slot >= 0) { // already a miss of this batch
+			source[i] = c->getPending(slot);
+		} else {
+			source[i] = misses.size();
+			missSlots.push_back(c->reserve(key, misses.size()));
+			misses.a.push_back(key[0]);
+			misses.b.push_back(key[1]);
+			misses.c.push_back(key[2]);
+			misses.d.push_back(key[3]);
+		}
+	}
+
+	int nMisses = misses.size();
+	vector<float> computed((size_t) nScores * nMisses);
+
+	for (int k = 0; k < nScores; ++k) {
+		kernels[k](misses, smoothingParam, computed.data() + (size_t) k * nMisses);
+	}
+
+	for (int m = 0; m < nMisses; ++m) {
+		// the slot may have been taken by a later miss
+		if (c->getPending(missSlots[m]) == m) {
+			c->setScores(missSlots[m], computed.data() + m, nMisses);
+		}
+	}
+
+	for (int i = 0; i < n; ++i) {
+		if (source[i] >= 0) {
+			for (int k = 0; k < nScores; ++k) {
+				res[k][i] = computed[(size_t) k * nMisses + source[i]];
+			}
+		}
 	}
 
 	return res;
@@ -487,6 +1372,39 @@ vector<float> ScoreCalculator::compute()
 
 
 
+/**
+* @brief Add the contingency table of a candidate to the batch
+*
+* @param contingencyTable
+*/
+void ScoreCalculator::TableBatch::add(const vector<int> &contingencyTable)
+{
+	// n = 2 : only the first 4 values are used
+	a.push_back(contingencyTable[0]);
+	b.push_back(contingencyTable[1]);
+	c.push_back(contingencyTable[2]);
+	d.push_back(contingencyTable[3]);
+}
+
+
+
+void ScoreCalculator::TableBatch::clear()
+{
+	a.clear();
+	b.clear();
+	c.clear();
+	d.clear();
+}
+
+
+
+int ScoreCalculator::TableBatch::size() const
+{
+	return a.size();
+}
+
+
+
 /**
 * @brief Add a new type
 *
@@ -500,13 +1418,59 @@ vector<float> ScoreCalculator::compute()
 void ScoreCalculator::addType(string name, int freq,
 							  vector<string> contextNames, vector<int> contextFreqs)
 {
-	WordTypeSimplified *wts = new WordTypeSimplified();
-	wts->freq = (float) freq;
+	vector<UnigramStore::Entry> context;
+	fillContext(context, contextNames, contextFreqs);
+	store->add(internType(name), (float) freq, context);
+}
+
+
+
+/**
+* @brief Save the types entered with addType() in a binary file
+*
+* @param filename file to write
+* @param source identity of the statistics file (see getFileIdentity())
+*
+* @return false if the file could not be written
+*/
+bool ScoreCalculator::saveTypes(const string &filename,
+								unsigned long long source) const
+{
+	vector<string> names(typeIds->size());
+
+	for (const auto &t : *typeIds) {
+		names[t.second] = t.first;
+	}
+
+	return store->save(filename, names, source);
+}
+
+
+
+/**
+* @brief Load types saved with saveTypes(), instead of calling addType()
+*
+* @param filename file saved by saveTypes()
+* @param source identity of the statistics file (see getFileIdentity())
+*
+* @return false if the file is not a valid file of types saved from that
+* statistics file
+*/
+bool ScoreCalculator::loadTypes(const string &filename,
+								unsigned long long source)
+{
+	vector<string> names;
+
+	if (!store->load(filename, names, source)) {
+		return false;
+	}
+
+	typeIds->clear();
 
-	for (int i = 0; i < (int) contextNames.size(); ++i) {
-		wts->context[contextNames[i]] = (float) contextFreqs[i];
+	for (int id = 0; id < (int) names.size(); ++id) {
+		(*typeIds)[names[id]] = id;
 	}
 
-	types[name] = wts;
+	return true;
 }
 }
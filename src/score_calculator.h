@@ -2,9 +2,12 @@
 #define SCORE_CALCULATOR_H_
 
 #include "word_type.h"
+#include "score_cache.h"
+#include "unigram_store.h"
 
 #include <vector>
 #include <unordered_map>
+#include <memory>
 
 namespace mwer{
 /**
@@ -15,48 +18,142 @@ namespace mwer{
 *
 */
 class ScoreCalculator {
+	public:
+		/**
+		* @brief Values derived from the contingency table of a 2-gram
+		*/
+		struct TableValues {
+			float a, b, c, d; // contingency table values
+			float sa, sb, sc, sd; // smoothed values
+			float N; // total number of candidates
+			float p_xy; // p(xy);
+			float p_x_star;	// p(x*)
+			float p_star_y; // p(*y)
+		};
+
+		/**
+		* @brief Values derived from the 2^n contingency table of a n-gram
+		*
+		* Positions of the types are the bits of the masks : bit i is the
+		* i-th type.
+		*/
+		struct NgramValues {
+			int n; // number of types, at most 4
+			double N; // total number of candidates
+			double a; // f(w_1...w_n)
+			double marginals[4]; // f(w_i)
+			double prefixes[4]; // prefixes[i] = f(w_1...w_i), 0 < i < n
+			double suffixes[4]; // suffixes[i] = f(w_i+1...w_n), 0 < i < n
+			// observed[m] : frequency of the n-grams where exactly the
+			// types in m occur at their position
+			double observed[16];
+		};
+
+		/**
+		* @brief Groups of values a measure needs besides a, b, c, d
+		*/
+		enum TableNeeds {
+			NEEDS_COUNTS = 0,
+			NEEDS_SMOOTHED = 1,
+			NEEDS_PROBABILITIES = 2,
+			NEEDS_NGRAM = 4 // NgramValues
+		};
+
+		/**
+		* @brief Contingency tables of a block of candidates, one column per cell
+		*/
+		struct TableBatch {
+			std::vector<float> a, b, c, d;
+
+			void add(const std::vector<int> &contingencyTable);
+			void clear();
+			int size() const;
+		};
+
+		typedef float (*TableScore)(const TableValues &);
+		typedef float (*NgramScore)(const NgramValues &);
+		typedef void (*Kernel)(const TableBatch &, float, float *);
+
 	private:
 		typedef std::unordered_map<std::string, float> Context;
 		typedef std::function<float()> Score;
-		struct WordTypeSimplified {
-			float freq;
-			Context context;
+		/**
+		* @brief Context as (type id, frequency) pairs sorted by type id
+		*
+		* The entries are stored elsewhere : in the UnigramStore or in
+		* broadEntries.
+		*/
+		struct SparseContext {
+			const UnigramStore::Entry *begin;
+			const UnigramStore::Entry *end;
+			float boolNorm; // norm with boolean weights : sqrt(size())
+
+			int size() const;
 		};
 
 		bool hasImmediateContext;
 		bool hasBroadContext;
 		std::vector<int> scoresToCompute;
 		float smoothingParam;
+		int needs; // TableNeeds of the scores to compute
 
 		std::vector<Context> immediateContexts;
-		Context broadContext;
+		std::vector<UnigramStore::Entry> broadEntries;
+		SparseContext broadContext;
 
 		std::vector<float> table; // contingency table
-		std::unordered_map<int, Score> scores;
-
-		std::unordered_map<std::string, WordTypeSimplified *> types;
-		std::vector < std::pair < std::string,
-			WordTypeSimplified * > > typesCandidates;
-		float p_xy; // p(xy);
-		float p_x_star;	// p(x*)
-		float p_star_y; // p(*y)
-		float a, b, c, d; // contingency table values
-		float sa, sb, sc, sd; // smoothed values
-		float N; // total number of candidates
-		Context *Cx;
-		Context *Cy;
+		std::unordered_map<int, Score> scores; // measures using contexts
+
+		// Scores to compute, in order : either a measure of the 2-gram table
+		// (tableScores and kernels), a measure of the n-gram table
+		// (ngramScores) or a measure using contexts (contextScores)
+		std::vector<TableScore> tableScores;
+		std::vector<Kernel> kernels;
+		std::vector<NgramScore> ngramScores;
+		std::vector<Score> contextScores;
+		// cellMasks[n] : mask of the subcandidate of each cell of the table,
+		// see ContextCandidate::contingencyOrder()
+		std::vector<std::vector<int> > cellMasks;
+
+		// Type names are interned : contexts refer to types by id. The names
+		// interned by the model are shared with its copies, which only read
+		// them and intern the names they meet first in newTypeIds.
+		typedef std::unordered_map<std::string, int> TypeIds;
+		std::shared_ptr<TypeIds> typeIds;
+		TypeIds newTypeIds;
+		UnigramStore *store; // types entered with addType()
+		bool ownsStore; // false for copies sharing the types of another
+		bool usesIndex; // whether a score needs the inverted index of store
+		// Without context, scores only depend on the contingency table
+		ScoreCache *cache; // created at the first table, if no context
+		int cachedSlot; // slot of the current candidate, -1 if not cached
+		std::vector<int> typesCandidates; // ids
+		TableValues v; // values of the current candidate
+		NgramValues ngram;
+		SparseContext Cx;
+		SparseContext Cy;
+
+		void defineContextScores();
+		void computeNgramValues();
+		ScoreCache *getCache(int keySize);
 
 		// Context utilities
-		std::pair<std::vector<float>, std::vector<float> >
-		IntersectContexts(Context &, Context &);
-		float ccosBool(Context &, Context &);
-		float cdiceTF(Context &, Context &);
+		int internType(const std::string &name);
+		void fillContext(std::vector<UnigramStore::Entry> &entries,
+						 const std::vector<std::string> &names,
+						 const std::vector<int> &freqs);
+		SparseContext contextOf(int id) const;
+		float ccosBool(const SparseContext &, const SparseContext &);
+		float cdiceTF(const SparseContext &, const SparseContext &);
 
 	public:
 		enum ContextSide {LEFT = 0, RIGHT = 1};
 
 		ScoreCalculator(bool immediate, bool broad,
 						std::vector<int> toCompute, float smoothingParam);
+		ScoreCalculator(const ScoreCalculator &model);
+		// store and cache are owned : a calculator cannot be assigned
+		ScoreCalculator &operator=(const ScoreCalculator &) = delete;
 		~ScoreCalculator();
 
 		void newCandidate();
@@ -68,9 +165,17 @@ class ScoreCalculator {
 		void addToBroadContext(std::vector<std::string> types,
 			 										std::vector<int> freqs);
 		std::vector<float> compute();
+		bool canComputeBatch() const;
+		bool onlyNgramScores() const;
+		long long getCacheLookups() const;
+		long long getCacheHits() const;
+		std::vector<std::vector<float> > computeBatch(const TableBatch &batch);
 		void addType(std::string name, int freq,
 			 					std::vector<std::string> contextNames,
 							 	std::vector<int> contextFreqs);
+		bool saveTypes(const std::string &filename,
+					   unsigned long long source) const;
+		bool loadTypes(const std::string &filename, unsigned long long source);
 };
 }
 
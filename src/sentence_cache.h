@@ -0,0 +1,84 @@
+/*
+mwer : multi-word expressions extractor
+Copyright (C) 2013  Tom Bosc
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef SENTENCE_CACHE_H_
+#define SENTENCE_CACHE_H_
+
+#include <list>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+
+namespace mwer{
+/**
+* @brief A LRU cache of the candidates occurrences found in sentences
+*
+* Corpora often contain the same sentence many times. A sentence is
+* identified by the sequence of its (type id, parent id), and the cache
+* stores the occurrences of candidates found in it, so that they can be
+* replayed instead of enumerating the sentence again.
+*
+* @tparam R Record of an occurrence of a candidate
+*/
+template<class R>
+class SentenceCache {
+	public:
+		typedef std::vector<std::pair<int, int> > Key;
+
+		/**
+		* @brief A cached sentence
+		*/
+		struct Entry {
+			Key key;
+			size_t hash;
+			std::vector<R> records;
+			double cost; // seconds spent enumerating the sentence
+		};
+
+	private:
+		typedef typename std::list<Entry>::iterator entry_iterator;
+
+		size_t capacity;
+		std::list<Entry> entries; // most recently used first
+		std::unordered_multimap<size_t, entry_iterator> index;
+
+		long long hits;
+		long long misses;
+		double savedTime;
+
+	public:
+		SentenceCache(size_t capacity);
+
+		static size_t hash(const Key &key);
+		const Entry *find(const Key &key, size_t hash);
+		void insert(const Key &key, size_t hash, std::vector<R> &records,
+					double cost);
+
+		void mergeStatistics(const SentenceCache &other);
+
+		size_t getCapacity() const;
+		long long getHits() const;
+		long long getMisses() const;
+		double getSavedTime() const;
+};
+}
+
+#include "sentence_cache.tpp"
+
+#endif
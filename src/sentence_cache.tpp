@@ -0,0 +1,185 @@
+/*
+mwer : multi-word expressions extractor
+Copyright (C) 2013  Tom Bosc
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+namespace mwer{
+/**
+* @param capacity Maximal number of sentences kept in the cache
+*/
+template<class R>
+SentenceCache<R>::SentenceCache(size_t capacity) :
+	capacity(capacity),
+	hits(0),
+	misses(0),
+	savedTime(0)
+{
+}
+
+
+
+/**
+* @brief Hash a sentence
+*
+* @param key Sequence of (type id, parent id) of the sentence
+*/
+template<class R>
+size_t SentenceCache<R>::hash(const Key &key)
+{
+	size_t h = key.size();
+
+	for (auto &k : key) {
+		h ^= (size_t) k.first + 0x9e3779b9 + (h << 6) + (h >> 2);
+		h ^= (size_t) k.second + 0x9e3779b9 + (h << 6) + (h >> 2);
+	}
+
+	return h;
+}
+
+
+
+/**
+* @brief Look for a sentence in the cache
+*
+* A found sentence becomes the most recently used one.
+*
+* @param key Sequence of (type id, parent id) of the sentence
+* @param hash Hash of the key
+*
+* @return the cached sentence, or 0 if it is not in the cache
+*/
+template<class R>
+const typename SentenceCache<R>::Entry *SentenceCache<R>::find(const Key &key,
+															   size_t hash)
+{
+	auto range = index.equal_range(hash);
+
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second->key == key) {
+			entries.splice(entries.begin(), entries, it->second);
+			++hits;
+			savedTime += it->second->cost;
+			return &*(it->second);
+		}
+	}
+
+	++misses;
+	return 0;
+}
+
+
+
+/**
+* @brief Store the occurrences found in a sentence
+*
+* If the cache is full, the least recently used sentence is dropped.
+*
+* @param key Sequence of (type id, parent id) of the sentence
+* @param hash Hash of the key
+* @param records Occurrences found in the sentence (moved into the cache)
+* @param cost Time spent to enumerate the sentence, in seconds
+*/
+template<class R>
+void SentenceCache<R>::insert(const Key &key, size_t hash,
+							  std::vector<R> &records, double cost)
+{
+	if (capacity == 0) {
+		return;
+	}
+
+	if (entries.size() == capacity) {
+		Entry &last = entries.back();
+		auto range = index.equal_range(last.hash);
+
+		for (auto it = range.first; it != range.second; ++it) {
+			if (&*(it->second) == &last) {
+				index.erase(it);
+				break;
+			}
+		}
+
+		entries.pop_back();
+	}
+
+	entries.push_front(Entry());
+	Entry &e = entries.front();
+	e.key = key;
+	e.hash = hash;
+	e.records.swap(records);
+	e.cost = cost;
+	index.insert(std::make_pair(hash, entries.begin()));
+}
+
+
+
+/**
+* @brief Add the hits, misses and saved time of another cache
+*
+* @param other cache used on another part of the corpus
+*/
+template<class R>
+void SentenceCache<R>::mergeStatistics(const SentenceCache &other)
+{
+	hits += other.hits;
+	misses += other.misses;
+	savedTime += other.savedTime;
+}
+
+
+
+/**
+* @return Maximal number of sentences kept in the cache
+*/
+template<class R>
+size_t SentenceCache<R>::getCapacity() const
+{
+	return capacity;
+}
+
+
+
+/**
+* @return Number of sentences found in the cache
+*/
+template<class R>
+long long SentenceCache<R>::getHits() const
+{
+	return hits;
+}
+
+
+
+/**
+* @return Number of sentences not found in the cache
+*/
+template<class R>
+long long SentenceCache<R>::getMisses() const
+{
+	return misses;
+}
+
+
+
+/**
+* @return Time of enumeration saved by the cache, in seconds
+*/
+template<class R>
+double SentenceCache<R>::getSavedTime() const
+{
+	return savedTime;
+}
+}
@@ -49,6 +49,69 @@ std::string getExtension(std::string f)
 
 
 
+/**
+* @brief Insert a suffix in a filename, before its extensions
+*
+* example : insertSuffix("dir/out.txt.gz", "dn2") returns "dir/out.dn2.txt.gz"
+*
+* @param f Path or filename
+* @param suffix Suffix to insert
+*
+* @return Filename with the suffix
+*/
+std::string insertSuffix(std::string f, std::string suffix)
+{
+	size_t start = f.find_last_of('/');
+	start = (start == std::string::npos) ? 0 : start + 1;
+	size_t dot = f.find('.', start);
+
+	if (dot == std::string::npos) {
+		return f + "." + suffix;
+	}
+
+	return f.substr(0, dot) + "." + suffix + f.substr(dot);
+}
+
+
+
+/**
+* @brief Identity of a file, to recognize the file a derived file was built
+* from
+*
+* @param f Path of the file
+*
+* @return hash of the absolute path, the size and the modification time of
+* f, 0 if f cannot be found
+*/
+unsigned long long getFileIdentity(std::string f)
+{
+	boost::system::error_code error;
+	boost::filesystem::path path = boost::filesystem::canonical(f, error);
+
+	if (error) {
+		return 0;
+	}
+
+	std::ostringstream key;
+	key << path.string() << '\0' << boost::filesystem::file_size(path, error);
+	key << '\0' << boost::filesystem::last_write_time(path, error);
+
+	if (error) {
+		return 0;
+	}
+
+	// FNV-1a
+	unsigned long long h = 14695981039346656037ULL;
+
+	for (unsigned char c : key.str()) {
+		h = (h ^ c) * 1099511628211ULL;
+	}
+
+	return h;
+}
+
+
+
 /**
 * @brief Get an input stream out of a gzip'ed file
 *
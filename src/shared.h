@@ -59,6 +59,10 @@ std::unique_ptr<std::ostream> getCompressedStream(std::ofstream& file);
 
 std::string getExtension(std::string f);
 
+std::string insertSuffix(std::string f, std::string suffix);
+
+unsigned long long getFileIdentity(std::string f);
+
 void getRange(std::string s, int &min, int &max);
 
 std::vector<std::string> split(std::string s, char sep);
@@ -0,0 +1,362 @@
+/*
+mwer : multi-word expressions extractor
+Copyright (C) 2013  Tom Bosc
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "space_saving.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace mwer{
+/**
+* @param capacity Maximal number of types counted
+*/
+SpaceSaving::SpaceSaving(int capacity) :
+	capacity(capacity)
+{
+}
+
+
+
+unsigned int SpaceSaving::hashId(int id)
+{
+	unsigned int h = (unsigned int) id * 0x9e3779b1u;
+	return h ^ (h >> 16);
+}
+
+
+
+/**
+* @return slot of a type id, or the empty slot where it would be stored
+*/
+int SpaceSaving::findSlot(int id) const
+{
+	int mask = slots.size() - 1;
+	int s = hashId(id) & mask;
+
+	while (slots[s] != 0 && heap[slots[s] - 1].id != id) {
+		s = (s + 1) & mask;
+	}
+
+	return s;
+}
+
+
+
+/**
+* @return index in the heap of a type id, -1 if it is not counted
+*/
+int SpaceSaving::find(int id) const
+{
+	if (slots.empty()) {
+		return -1;
+	}
+
+	return slots[findSlot(id)] - 1;
+}
+
+
+
+void SpaceSaving::setPosition(int id, int i)
+{
+	slots[findSlot(id)] = i + 1;
+}
+
+
+
+/**
+* @brief Free the slot of a type id
+*
+* The next slots of the cluster are shifted back, so that every id stays
+* reachable from its hash without tombstones.
+*/
+void SpaceSaving::erasePosition(int id)
+{
+	int mask = slots.size() - 1;
+	int hole = findSlot(id);
+	int s = hole;
+	slots[hole] = 0;
+
+	while (true) {
+		s = (s + 1) & mask;
+
+		if (slots[s] == 0) {
+			return;
+		}
+
+		int home = hashId(heap[slots[s] - 1].id) & mask;
+
+		// the id can fill the hole if its home is not between the hole
+		// (excluded) and its slot (included)
+		if (((s - home) & mask) >= ((s - hole) & mask)) {
+			slots[hole] = slots[s];
+			slots[s] = 0;
+			hole = s;
+		}
+	}
+}
+
+
+
+/**
+* @brief Make room in the table of positions for size counters
+*
+* The table is kept at most half full.
+*/
+void SpaceSaving::reserveSlots(int size)
+{
+	if (2 * size <= (int) slots.size()) {
+		return;
+	}
+
+	int n = 16;
+
+	while (n < 2 * size) {
+		n *= 2;
+	}
+
+	slots.assign(n, 0);
+
+	for (int i = 0; i < (int) heap.size(); ++i) {
+		setPosition(heap[i].id, i);
+	}
+}
+
+
+
+void SpaceSaving::swapCounters(int i, int j)
+{
+	// the slots are found while they still match the counters
+	int si = findSlot(heap[i].id);
+	int sj = findSlot(heap[j].id);
+	std::swap(heap[i], heap[j]);
+	slots[si] = j + 1;
+	slots[sj] = i + 1;
+}
+
+
+
+void SpaceSaving::siftUp(int i)
+{
+	while (i > 0 && heap[(i - 1) / 2].count > heap[i].count) {
+		swapCounters(i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+
+
+void SpaceSaving::siftDown(int i)
+{
+	int size = heap.size();
+
+	while (true) {
+		int smallest = i;
+		int left = 2 * i + 1;
+		int right = left + 1;
+
+		if (left < size && heap[left].count < heap[smallest].count) {
+			smallest = left;
+		}
+
+		if (right < size && heap[right].count < heap[smallest].count) {
+			smallest = right;
+		}
+
+		if (smallest == i) {
+			return;
+		}
+
+		swapCounters(i, smallest);
+		i = smallest;
+	}
+}
+
+
+
+void SpaceSaving::remove(int i)
+{
+	int last = heap.size() - 1;
+	erasePosition(heap[i].id);
+
+	if (i == last) {
+		heap.pop_back();
+		return;
+	}
+
+	int id = heap[last].id;
+	slots[findSlot(id)] = i + 1;
+	heap[i] = heap[last];
+	heap.pop_back();
+	siftUp(i);
+	siftDown(find(id));
+}
+
+
+
+/**
+* @return count of the lightest type if the summary is full, 0 otherwise :
+* a type that is not counted occurred at most this number of times
+*/
+int SpaceSaving::minimum() const
+{
+	return ((int) heap.size() < capacity) ? 0 : heap[0].count;
+}
+
+
+
+/**
+* @brief Count occurrences of a type
+*
+* @param id id of the type
+* @param count number of occurrences
+*/
+void SpaceSaving::add(int id, int count)
+{
+	int i = find(id);
+
+	if (i >= 0) {
+		heap[i].count += count;
+		siftDown(i);
+	} else if ((int) heap.size() < capacity) {
+		reserveSlots(heap.size() + 1);
+		heap.push_back({id, count});
+		setPosition(id, heap.size() - 1);
+		siftUp(heap.size() - 1);
+	} else if (capacity > 0) {
+		// the lightest type is replaced
+		Counter &lightest = heap[0];
+		erasePosition(lightest.id);
+		lightest.count += count;
+		lightest.id = id;
+		setPosition(id, 0);
+		siftDown(0);
+	}
+}
+
+
+
+/**
+* @brief Remove occurrences of a type, if it is counted
+*
+* @param id id of the type
+* @param count number of occurrences
+*/
+void SpaceSaving::subtract(int id, int count)
+{
+	int i = find(id);
+
+	if (i < 0) {
+		return;
+	}
+
+	heap[i].count -= count;
+
+	if (heap[i].count <= 0) {
+		remove(i);
+	} else {
+		siftUp(i);
+	}
+}
+
+
+
+/**
+* @brief Add the summary of another part of the corpus
+*
+* A type missing from one summary is counted as if it had the minimal count
+* of that summary, so that counts stay overestimated. Then the heaviest
+* types are kept.
+*
+* @param other summary with the same capacity
+*/
+void SpaceSaving::merge(const SpaceSaving &other)
+{
+	std::unordered_map<int, Counter> merged;
+
+	for (auto &c : heap) {
+		Counter m = c;
+		m.count += other.minimum();
+		merged[c.id] = m;
+	}
+
+	for (auto &c : other.heap) {
+		auto m = merged.find(c.id);
+
+		if (m != merged.end()) {
+			m->second.count += c.count - other.minimum();
+		} else {
+			merged[c.id] = {c.id, c.count + minimum()};
+		}
+	}
+
+	std::vector<Counter> counters;
+
+	for (auto &m : merged) {
+		counters.push_back(m.second);
+	}
+
+	// heaviest first, ties broken by id to stay deterministic
+	std::sort(counters.begin(), counters.end(),
+	[] (const Counter &a, const Counter &b) {
+		return a.count > b.count || (a.count == b.count && a.id < b.id);
+	});
+
+	if ((int) counters.size() > capacity) {
+		counters.resize(capacity);
+	}
+
+	heap.clear();
+	slots.clear();
+	reserveSlots(counters.size());
+
+	for (auto &c : counters) {
+		heap.push_back(c);
+		setPosition(c.id, heap.size() - 1);
+		siftUp(heap.size() - 1);
+	}
+}
+
+
+
+int SpaceSaving::getCapacity() const
+{
+	return capacity;
+}
+
+
+
+/**
+* @brief List the types counted
+*
+* @param entries vector to fill
+*
+* @return (type id, count) sorted by id
+*/
+const SpaceSaving::Entries &SpaceSaving::getEntries(Entries &entries) const
+{
+	entries.clear();
+
+	for (auto &c : heap) {
+		entries.push_back(std::make_pair(c.id, c.count));
+	}
+
+	std::sort(entries.begin(), entries.end());
+	return entries;
+}
+}
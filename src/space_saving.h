@@ -0,0 +1,77 @@
+/*
+mwer : multi-word expressions extractor
+Copyright (C) 2013  Tom Bosc
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef SPACE_SAVING_H_
+#define SPACE_SAVING_H_
+
+#include <vector>
+#include <utility>
+
+namespace mwer{
+/**
+* @brief A summary keeping the heaviest types of a context
+*
+* This is the space-saving algorithm : at most capacity types are counted.
+* When a new type comes and the summary is full, it replaces the lightest
+* type and inherits its count. Counts are therefore overestimated, by at
+* most (sum of the counts) / capacity, and every type whose count is larger
+* than this bound is kept.
+*
+* The counters are kept in a min-heap. They are indexed by type id in an
+* open addressing table of heap positions, which grows with the heap : a
+* counted type costs 3 or 4 ints.
+*/
+class SpaceSaving {
+	public:
+		typedef std::vector<std::pair<int, int> > Entries;
+
+	private:
+		struct Counter {
+			int id;
+			int count;
+		};
+
+		int capacity;
+		std::vector<Counter> heap;
+		std::vector<int> slots; // index in heap + 1, 0 if the slot is empty
+
+		static unsigned int hashId(int id);
+		int findSlot(int id) const;
+		int find(int id) const;
+		void setPosition(int id, int i);
+		void erasePosition(int id);
+		void reserveSlots(int size);
+		void swapCounters(int i, int j);
+		void siftUp(int i);
+		void siftDown(int i);
+		void remove(int i);
+		int minimum() const;
+
+	public:
+		SpaceSaving(int capacity);
+
+		void add(int id, int count = 1);
+		void subtract(int id, int count);
+		void merge(const SpaceSaving &other);
+		int getCapacity() const;
+		const Entries &getEntries(Entries &entries) const;
+};
+}
+
+#endif
@@ -21,14 +21,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <map>
 #include <algorithm>
+#include <functional>
 
 #include "candidate.h"
 
 namespace mwer{
 using namespace std;
 
-long long StatisticExtractor::N = 0;
-
 /**
 * @brief Build a statistic extractor
 *
@@ -51,18 +50,79 @@ StatisticExtractor::StatisticExtractor(int n, int nFactors, int surfMin,
 									   int surfMax, bool dependency, bool immediate, bool broad,
 									   std::string tagFilter) :
 	CandidateExtractor<ContextCandidate>(n, nFactors, surfMin, surfMax, dependency),
+	N(0),
 	immediateContext(immediate),
 	broadContext(broad),
 	subcandidates(n - 1),
 	filterContext(!tagFilter.empty()),
-	tagFilter(tagFilter)
+	tagFilter(tagFilter),
+	tagRegex(tagFilter),
+	contextTopK(0),
+	unigramKey(1),
+	probe({}, {}, 0),
+	bloom(0),
+	index(0),
+	nProbes(0),
+	nRejected(0),
+	nSentencesWithoutCandidate(0),
+	parent(0),
+	processingStart(0)
+{
+}
+
+
+
+/**
+* @brief Build a worker counting the candidates of another extractor
+*
+* @param parent extractor whose parameters and candidates are used
+*/
+StatisticExtractor::StatisticExtractor(StatisticExtractor *parent) :
+	CandidateExtractor<ContextCandidate>(parent->n, parent->nFactors,
+										 parent->surfMin, parent->surfMax,
+										 parent->extractDependency),
+	N(0),
+	immediateContext(parent->immediateContext),
+	broadContext(parent->broadContext),
+	subcandidates(parent->n - 1),
+	filterContext(parent->filterContext),
+	tagFilter(parent->tagFilter),
+	tagRegex(parent->tagRegex),
+	contextTopK(parent->contextTopK),
+	unigramKey(1),
+	probe({}, {}, 0),
+	bloom(0),
+	index(0),
+	nProbes(0),
+	nRejected(0),
+	nSentencesWithoutCandidate(0),
+	parent(parent),
+	processingStart(0)
 {
+	setSentenceBudget(parent->budget);
+
+	if (parent->cache != 0) {
+		setSentenceCache(parent->cache->getCapacity());
+	}
 }
 
 
 
 StatisticExtractor::~StatisticExtractor()
 {
+	waitBatch();
+
+	for (auto &w : workers) {
+		delete w;
+	}
+
+	for (auto &s : shadows) {
+		delete s.second;
+	}
+
+	delete bloom;
+	delete index;
+
 	for (auto &sc : subcandidates) {
 		for (auto &c : sc) {
 			delete c;
@@ -83,11 +143,44 @@ StatisticExtractor::~StatisticExtractor()
 */
 void StatisticExtractor::updateBroadContext(ContextCandidate *candidate)
 {
+	for (auto &t : contextHistogram) {
+		candidate->addToContext(ContextCandidate::BROAD, t.first, t.second);
+	}
+}
+
+
+
+/**
+* @brief Count the occurrences of each type of the current sentence
+*
+* The types are interned, so they are counted in an array indexed by their
+* id. The broad contexts are then updated once per type, not per token.
+*/
+void StatisticExtractor::buildHistogram()
+{
+	histogram.clear();
+	contextHistogram.clear();
+
 	for (auto t = sentence.begin() + 1; t != sentence.end(); ++t) {
 		WordType *wt = (*t)->getWordType();
+		unsigned int id = wt->getId();
 
-		if (canAddToContext(wt)) {
-			candidate->addToContext(ContextCandidate::BROAD, (*t)->getWordType());
+		if (id >= typeCounts.size()) {
+			typeCounts.resize(id + 1, 0);
+		}
+
+		if (typeCounts[id]++ == 0) {
+			histogram.push_back(make_pair(wt, 0));
+		}
+	}
+
+	for (auto &h : histogram) {
+		int &count = typeCounts[h.first->getId()];
+		h.second = count;
+		count = 0;
+
+		if (canAddToContext(h.first)) {
+			contextHistogram.push_back(h);
 		}
 	}
 }
@@ -111,39 +204,105 @@ void StatisticExtractor::updateBroadContext(ContextCandidate *candidate)
 * @param tNext type corresponding to the token on the rught of the occurence
 * of the candidate
 */
-void StatisticExtractor::computeStats(vector<WordType *> types,
-									  vector<int> pids,
+void StatisticExtractor::computeStats(const vector<WordType *> &types,
+									  const vector<int> &pids,
 									  int unused, WordType *tPrev, WordType *tNext)
 {
 	// we do not add the candidate, it should already exist
 	// if it doesn't exist, it means that it has been filtered out
 	// so it means we don't want to consider it
-	ContextCandidate *c = new ContextCandidate(types, pids, 0);
-	auto res = candidates.find(c);
+	const BloomFilter *filter = (parent != 0) ? parent->bloom : bloom;
+	++nProbes;
+
+	if (filter != 0 && !filter->mayContain(Candidate::keyHash(types, pids))) {
+		++nRejected;
+		return;
+	}
 
-	if (res != candidates.end()) {
-		delete c;
-		c = *res;
+	probe.setKey(types, pids);
+	candidate_set &known = (parent != 0) ? parent->candidates : candidates;
+	auto res = known.find(&probe);
 
-		if (immediateContext) {
-			if (tPrev != 0 && canAddToContext(tPrev)) {
-				c->addToContext(ContextCandidate::LEFT, tPrev);
-			}
+	if (res != known.end()) {
+		ContextCandidate *c = *res;
+
+		if (parent != 0) {
+			// a worker counts in its own copy of the candidate
+			auto &shadow = shadows[c];
 
-			if (tNext != 0 && canAddToContext(tNext)) {
-				c->addToContext(ContextCandidate::RIGHT, tNext);
+			if (shadow == 0) {
+				shadow = c->emptyCopy();
 			}
+
+			c = shadow;
 		}
 
-		if (broadContext) {
-			updateBroadContext(c);
+		countOccurrence(c, tPrev, tNext);
+
+		if (recording) {
+			occurrences.push_back({0, c, tPrev, tNext});
 		}
+	}
+}
+
+
 
-		c->updateStatistics();
-		++StatisticExtractor::N;
-	} else {
-		delete c;
+/**
+* @brief Count an occurrence of a candidate and update its contexts
+*
+* @param c candidate
+* @param tPrev type corresponding to the token on the left of the occurence
+* @param tNext type corresponding to the token on the right of the occurence
+*/
+void StatisticExtractor::countOccurrence(ContextCandidate *c, WordType *tPrev,
+										 WordType *tNext)
+{
+	if (immediateContext) {
+		if (tPrev != 0 && canAddToContext(tPrev)) {
+			c->addToContext(ContextCandidate::LEFT, tPrev);
+		}
+
+		if (tNext != 0 && canAddToContext(tNext)) {
+			c->addToContext(ContextCandidate::RIGHT, tNext);
+		}
 	}
+
+	if (broadContext) {
+		updateBroadContext(c);
+	}
+
+	c->updateStatistics();
+	++N;
+}
+
+
+
+/**
+* @brief Count again an occurrence found in a cached sentence
+*
+* The broad context is taken from the current sentence, which is the same
+* as the cached one.
+*
+* @param o occurrence
+*/
+void StatisticExtractor::replayOccurrence(const Occurrence &o)
+{
+	countOccurrence(o.candidate, o.prev, o.next);
+}
+
+
+
+/**
+* @brief Apply the tag filter to a new type
+*
+* The regular expression is compiled once, and evaluated once per type.
+*
+* @param type
+*/
+void StatisticExtractor::initWordType(WordType *type)
+{
+	type->setInContext(!filterContext ||
+					   boost::regex_match(type->getTag(), tagRegex));
 }
 
 
@@ -159,8 +318,206 @@ void StatisticExtractor::computeStats(vector<WordType *> types,
 */
 inline bool StatisticExtractor::canAddToContext(WordType *type)
 {
-	return !filterContext ||
-		   (filterContext && contains(type->getTag(), tagFilter));
+	return type->isInContext();
+}
+
+
+
+/**
+* @brief Keep only the k heaviest types of each broad context
+*
+* Broad contexts of frequent candidates and unigrams can grow as large as
+* the vocabulary. With this, each of them is a space-saving summary of k
+* types, whose counts are overestimated by at most (sum of the counts) / k.
+* This must be called before the candidates are added.
+*
+* @param k Maximal number of types per broad context
+*/
+void StatisticExtractor::setContextTopK(int k)
+{
+	contextTopK = k;
+}
+
+
+
+/**
+* @brief Read the corpus with several threads
+*
+* The sentences are then counted by batches : while the workers count a
+* batch, the next one is read. This must be called after the candidates
+* list has been read, and after @ref setSentenceCache and
+* @ref setSentenceBudget.
+*
+* @param nThreads Number of workers
+*/
+void StatisticExtractor::setThreads(int nThreads)
+{
+	for (int i = 0; i < nThreads; ++i) {
+		workers.push_back(new StatisticExtractor(this));
+	}
+
+	batch.reserve(SENTENCES_PER_BATCH);
+}
+
+
+
+/**
+* @brief Count the occurrences in a range of sentences
+*
+* The tokens are deleted once counted.
+*
+* @param begin First sentence of the range
+* @param end End of the range
+* @param first Index of the first sentence of the range in the corpus
+*/
+void StatisticExtractor::countSentences(batch_iterator begin, batch_iterator end,
+										long long first)
+{
+	for (auto s = begin; s != end; ++s) {
+		sentence.insert(sentence.end(), s->begin(), s->end());
+		// numbering of the sentences reported by the budget
+		nSentences = first + (s - begin);
+		updateStatistics();
+	}
+}
+
+
+
+/**
+* @brief Hand the current batch over to the workers
+*
+* Each worker counts a contiguous part of the batch.
+*/
+void StatisticExtractor::runBatch()
+{
+	waitBatch();
+	processing.swap(batch);
+	batch.clear();
+	processingStart = nSentences - processing.size();
+	int nWorkers = workers.size();
+	int size = processing.size();
+
+	for (int w = 0; w < nWorkers; ++w) {
+		int begin = (long long) size * w / nWorkers;
+		int end = (long long) size * (w + 1) / nWorkers;
+		running.push_back(thread(&StatisticExtractor::countSentences, workers[w],
+								 processing.cbegin() + begin,
+								 processing.cbegin() + end,
+								 processingStart + begin));
+	}
+}
+
+
+
+/**
+* @brief Wait for the workers to count the batch handed over
+*/
+void StatisticExtractor::waitBatch()
+{
+	for (auto &t : running) {
+		t.join();
+	}
+
+	running.clear();
+	processing.clear();
+}
+
+
+
+/**
+* @brief Add the statistics of the workers to the candidates
+*/
+void StatisticExtractor::mergeWorkers()
+{
+	for (auto &w : workers) {
+		for (auto &s : w->shadows) {
+			s.first->merge(*s.second);
+		}
+
+		for (auto &u : w->unigrams) {
+			auto res = unigrams.insert(u);
+
+			if (!res.second) {
+				(*res.first)->merge(*u);
+				delete u;
+			}
+		}
+
+		w->unigrams.clear();
+		N += w->N;
+		nProbes += w->nProbes;
+		nRejected += w->nRejected;
+		nSentencesWithoutCandidate += w->nSentencesWithoutCandidate;
+		nSkippedSentences += w->nSkippedSentences;
+		nSkippedWords += w->nSkippedWords;
+
+		if (cache != 0) {
+			cache->mergeStatistics(*w->cache);
+		}
+
+		delete w;
+	}
+
+	workers.clear();
+}
+
+
+
+/**
+* @brief Insert the candidates in the Bloom filter and in the index guiding
+* the enumeration
+*
+* Most enumerated n-grams are not candidates : the filter rejects them
+* without hashing their strings nor comparing them, and the index prevents
+* most of them from being enumerated at all.
+*/
+void StatisticExtractor::indexCandidates()
+{
+	bloom = new BloomFilter(candidates.size());
+	index = new CandidateIndex();
+
+	for (auto &c : candidates) {
+		bloom->insert(c->keyHash());
+		index->insert(c->getTypes(), c->getParentIds());
+	}
+
+	guide = index;
+
+	for (auto &w : workers) {
+		w->guide = index;
+	}
+}
+
+
+
+/**
+* @return true if a type of the current sentence is in a candidate
+*/
+bool StatisticExtractor::containsCandidateType()
+{
+	for (auto t = sentence.begin() + 1; t != sentence.end(); ++t) {
+		if (guide->hasType((*t)->getWordType()->getId())) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+
+/**
+* @brief Output statistics about the corpus pass
+*
+* @param os stream to output to
+*/
+void StatisticExtractor::printRunStatistics(ostream &os)
+{
+	CandidateExtractor<ContextCandidate>::printRunStatistics(os);
+	os << "Sentences without any type of candidate : "
+	   << nSentencesWithoutCandidate << endl;
+	os << "Bloom filter : " << nRejected << " out of " << nProbes
+	   << " enumerated n-grams rejected before lookup" << endl;
 }
 
 
@@ -170,11 +527,47 @@ void StatisticExtractor::updateStatistics()
 	cb_candidate f = bind(&StatisticExtractor::computeStats,	this,
 						  _1, _2, _3, _4, _5);
 
-	if (extractDependency) {
-		computeDepCandidates(f);
-	} else if ((int) this->sentence.size() > n) {
-		// sentence must be long enough to process surface candidates
-		computeSurfCandidates(f);
+	if (parent == 0 && bloom == 0) {
+		indexCandidates();
+	}
+
+	if (!workers.empty()) {
+		// the tokens are handed over to a worker
+		++nSentences;
+		batch.push_back(vector<Token *>(sentence.begin() + 1, sentence.end()));
+		sentence.resize(1);
+
+		if (batch.size() == SENTENCES_PER_BATCH) {
+			runBatch();
+		}
+
+		return;
+	}
+
+	if (exceedsBudget()) {
+		// the sentence is skipped altogether, as in extract_candidates
+		clearSentence();
+		return;
+	}
+
+	if (broadContext) {
+		buildHistogram();
+	}
+
+	if (!containsCandidateType()) {
+		// nothing to enumerate, but the unigrams are still counted
+		++nSentencesWithoutCandidate;
+	} else if (cache == 0 || !replaySentence()) {
+		if (extractDependency) {
+			computeDepCandidates(f);
+		} else if ((int) this->sentence.size() > n) {
+			// sentence must be long enough to process surface candidates
+			computeSurfCandidates(f);
+		}
+
+		if (recording) {
+			storeSentence();
+		}
 	}
 
 	if (broadContext) {
@@ -182,43 +575,40 @@ void StatisticExtractor::updateStatistics()
 		// This can't be done through the compute...Candidates functions because
 		// the context would be added several times if a type appears in several
 		// candidates
+		// Each of the m occurrences of a type adds the m' occurrences of
+		// every other type to its context.
 		ContextCandidate *unigram;
-		WordType *type;
 
-		for (auto tok = sentence.begin() + 1;
-				tok != sentence.end(); ++tok) {
-			type = (*tok)->getWordType();
-			// We create a one-type subcandidate that we either add or fetch
-			unigram = new ContextCandidate({type}, {}, 0);
-			auto res = unigrams.insert(unigram);
+		for (auto &u : histogram) {
+			// We fetch the one-type subcandidate, or create it
+			unigramKey[0] = u.first;
+			probe.setKey(unigramKey, {});
+			auto res = unigrams.find(&probe);
 
-			if (!res.second) {
-				delete unigram;
-			}
+			if (res != unigrams.end()) {
+				unigram = *res;
+			} else {
+				unigram = new ContextCandidate(unigramKey, {}, 0);
 
-			unigram = *res.first;
-			// We update its stats and add every other types to its context
-			unigram->updateStatistics();
+				if (contextTopK > 0) {
+					unigram->limitBroadContext(contextTopK);
+				}
 
-			for (auto t = sentence.begin() + 1;
-					t != sentence.end(); ++t) {
-				WordType *wt = (*t)->getWordType();
+				unigrams.insert(unigram);
+			}
 
-				if (not(*(wt) == *type) && canAddToContext(wt)) {
-					unigram->addToContext(ContextCandidate::BROAD, wt);
+			unigram->countOccurrences(u.second);
+
+			for (auto &t : contextHistogram) {
+				if (t.first != u.first) {
+					unigram->addToContext(ContextCandidate::BROAD, t.first,
+										  u.second * t.second);
 				}
 			}
 		}
 	}
 
-	// clear the sentences informations
-	for (auto it = this->sentence.begin() + 1;
-			it != this->sentence.end(); ++it) {
-		delete *it;
-	}
-
-	this->sentence.clear();
-	this->sentence.push_back(&nullToken);
+	clearSentence();
 }
 
 
@@ -238,7 +628,18 @@ ContextCandidate* StatisticExtractor::addCandidate(vector<WordType *> types,
 									  vector<int> parentIds, int frequency){
 		ContextCandidate* c;
 		c = CandidateFilter<ContextCandidate>::addCandidate(types, parentIds, 0);
-		addSubcandidates(c, types, 0);
+
+		if (contextTopK > 0) {
+			c->limitBroadContext(contextTopK);
+		}
+
+		// the filter and the index are built again if the candidates change
+		delete bloom;
+		delete index;
+		bloom = 0;
+		index = 0;
+		guide = 0;
+		addSubcandidates(c, types);
 		return c;
 }
 
@@ -247,34 +648,42 @@ ContextCandidate* StatisticExtractor::addCandidate(vector<WordType *> types,
 /**
 * @brief add every subcandidate to the container subcandidates
 *
-* @param types Types composing the candidate
+* A subcandidate shared with a candidate already inserted is looked up
+* before being allocated.
 *
-* @return every subcandidate
+* @param candidate
+* @param types Types composing the candidate
 */
-void StatisticExtractor::addSubcandidates(ContextCandidate *candidate
-										  , vector<WordType *> types, int order)
+void StatisticExtractor::addSubcandidates(ContextCandidate *candidate,
+										  const vector<WordType *> &types)
 {
-	// NOTE : This function is unnecessarily written recursively. To rewrite
-
-	int n = candidate->getSize();
-
-	for (int i = 0; i < n; ++i) {
-		if (types[i] != 0) {
-			vector<WordType *> t = types;
-			t[i] = 0;
-			ContextCandidate *c = new ContextCandidate(t, {}, 0, order);
-			auto res = subcandidates[order].insert(c);
-
-			if (!res.second) { // subcandidate already exists
-				delete c;
+	int n = types.size();
+	vector<WordType *> t(n);
+
+	for (int mask = 1; mask < (1 << n) - 1; ++mask) {
+		int order = -1;
+
+		for (int i = 0; i < n; ++i) {
+			if (mask & (1 << i)) {
+				t[i] = 0;
+				++order;
+			} else {
+				t[i] = types[i];
 			}
+		}
 
-			candidate->addSubcandidate(*res.first);
+		probe.setKey(t, {}, order);
+		auto res = subcandidates[order].find(&probe);
+		ContextCandidate *c;
 
-			if (order < n - 2) {
-				addSubcandidates(candidate, t, order + 1);
-			}
+		if (res != subcandidates[order].end()) {
+			c = *res;
+		} else {
+			c = new ContextCandidate(t, {}, 0, order);
+			subcandidates[order].insert(c);
 		}
+
+		candidate->addSubcandidate(mask, c);
 	}
 }
 
@@ -294,22 +703,22 @@ void StatisticExtractor::outputData(unique_ptr<ostream> stream)
 
 		for (auto u = orderedUnigrams.begin(); u != orderedUnigrams.end(); ++u) {
 			*stream << **u << sep << (*u)->getFrequency();
-			*stream << sep << (*u)->printContext(ContextCandidate::BROAD) << endl;
+			*stream << sep << (*u)->printContext(ContextCandidate::BROAD, typesById) << endl;
 		}
 	}
 
 	auto orderedCandidates = orderedSet(candidates.begin(), candidates.end());
 
 	for (auto c = orderedCandidates.begin(); c != orderedCandidates.end(); ++c) {
-		*stream << **c << sep << (*c)->outputContingency(StatisticExtractor::N);
+		*stream << **c << sep << (*c)->outputContingency(N);
 
 		if (immediateContext) {
-			*stream << sep << (*c)->printContext(ContextCandidate::LEFT);
-			*stream << sep << (*c)->printContext(ContextCandidate::RIGHT);
+			*stream << sep << (*c)->printContext(ContextCandidate::LEFT, typesById);
+			*stream << sep << (*c)->printContext(ContextCandidate::RIGHT, typesById);
 		}
 
 		if (broadContext) {
-			*stream << sep << (*c)->printContext(ContextCandidate::BROAD);
+			*stream << sep << (*c)->printContext(ContextCandidate::BROAD, typesById);
 		}
 
 		*stream << endl;
@@ -326,8 +735,19 @@ void StatisticExtractor::outputData(unique_ptr<ostream> stream)
 */
 void StatisticExtractor::finish()
 {
-	// First correction : Broad context of candidates
+	if (!workers.empty()) {
+		if (!batch.empty()) {
+			runBatch();
+		}
+
+		waitBatch();
+		mergeWorkers();
+	}
+
 	for (auto & c : candidates) {
+		// Marginals : the subcandidates are counted once, from the candidates
+		c->countInSubcandidates();
+		// Correction : Broad context of candidates
 		c->substractTypesInContext();
 	}
 }
@@ -24,11 +24,20 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <vector>
 #include <string>
 #include <memory>
+#include <unordered_map>
+#include <thread>
+
+#include <boost/regex.hpp>
 
 #include "candidate_extractor.h"
 #include "context_candidate.h"
 #include "word_type.h"
 #include "token.h"
+#include "bloom_filter.h"
+#include "candidate_index.h"
+
+// number of sentences handed to the workers at once
+#define SENTENCES_PER_BATCH 4096
 
 namespace mwer{
 /**
@@ -38,26 +47,73 @@ namespace mwer{
 * a list, or straight from a corpus). This is done using inherited methods.
 * Then you will read the corpus in order to update statistics for every
 * candidates and subcandidates. This class implements such methods.
+*
+* The corpus can be read by several threads (see @ref setThreads). The
+* candidates are frozen once the list is read : each worker counts the
+* occurrences in its own copies of the candidates, which are merged in
+* @ref finish.
 */
 class StatisticExtractor : public CandidateExtractor<ContextCandidate> {
 	private:
 		typedef std::unordered_set< ContextCandidate *, CandidateHash, CandidateEq > candidate_set;
-		static long long N; // Total encountered candidates
+		long long N; // Total encountered candidates
 		bool immediateContext;
 		bool broadContext;
 		std::vector< candidate_set > subcandidates;
 		bool filterContext;
 		std::string tagFilter;
+		boost::regex tagRegex;
+		int contextTopK; // 0 if broad contexts are exact
 
 		candidate_set unigrams;
+		std::vector<WordType *> unigramKey;
+		ContextCandidate probe; // key to look up the candidates
+
+		// prefilter of the lookups and guide of the enumeration, built before
+		// the corpus pass
+		BloomFilter *bloom;
+		CandidateIndex *index;
+		long long nProbes;
+		long long nRejected;
+		long long nSentencesWithoutCandidate;
+		void indexCandidates();
+		bool containsCandidateType();
 
-		void addSubcandidates(ContextCandidate *, std::vector<WordType *>,
-							  int order);
+		// multi-threading
+		StatisticExtractor *parent; // extractor whose candidates are counted
+		std::unordered_map<ContextCandidate *, ContextCandidate *> shadows;
+		std::vector<StatisticExtractor *> workers;
+		std::vector<std::thread> running;
+		std::vector<std::vector<Token *> > batch;
+		std::vector<std::vector<Token *> > processing;
+		long long processingStart;
 
-		void computeStats(std::vector<WordType *> tokens, std::vector<int> pids,
+		StatisticExtractor(StatisticExtractor *parent);
+		typedef std::vector<std::vector<Token *> >::const_iterator batch_iterator;
+		void countSentences(batch_iterator begin, batch_iterator end,
+							long long first);
+		void runBatch();
+		void waitBatch();
+		void mergeWorkers();
+
+		void addSubcandidates(ContextCandidate *,
+							  const std::vector<WordType *> &types);
+
+		void computeStats(const std::vector<WordType *> &tokens,
+						  const std::vector<int> &pids,
 						  int unused, WordType *t1, WordType *t2);
 
+		void countOccurrence(ContextCandidate *, WordType *tPrev, WordType *tNext);
+		void replayOccurrence(const Occurrence &o);
+		// types of the current sentence and their number of occurrences
+		std::vector<std::pair<WordType *, int> > histogram;
+		// the same, restricted to the types accepted in contexts
+		std::vector<std::pair<WordType *, int> > contextHistogram;
+		std::vector<int> typeCounts; // indexed by type id
+
+		void buildHistogram();
 		void updateBroadContext(ContextCandidate *);
+		void initWordType(WordType *type);
 		bool canAddToContext(WordType *);
 		void outputData(std::unique_ptr<std::ostream>);
 
@@ -69,6 +125,9 @@ class StatisticExtractor : public CandidateExtractor<ContextCandidate> {
 
 		virtual ContextCandidate* addCandidate(std::vector<WordType *> t,
 											  std::vector<int> pids, int f = 0);
+		void setContextTopK(int k);
+		void setThreads(int nThreads);
+		void printRunStatistics(std::ostream &os);
 		void updateStatistics();
 		void finish();
 };
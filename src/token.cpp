@@ -35,7 +35,10 @@ using namespace std;
 * @param nFactors
 */
 Token::Token(int nFactors) :
-	factors(nFactors, "0")
+	factors(nFactors, "0"),
+	type(0),
+	id(0),
+	parentId(0)
 {
 }
 
@@ -50,7 +53,8 @@ Token::Token(int nFactors) :
 */
 Token::Token(int nFactors, std::string tok, int id) :
 	factors(nFactors),
-	id(id)
+	id(id),
+	parentId(0)
 {
 	factors = split(tok, SEP_FACTORS);
 
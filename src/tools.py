@@ -49,6 +49,34 @@ class Model(ft):
         ranking = self.model.decision_function(X).tolist()
         return (lines, ranking)
 
+    def export(self, output_file):
+        """Export a linear model as text, to be read by rank_candidates
+
+        Each line is a name and its tab separated values : means and
+        scales of the standardizer, weights and intercept of the model.
+
+        Args:
+            output_file: Text file to write
+        """
+        if not hasattr(self.model, 'coef_') or len(self.model.coef_) != 1:
+            print "Error: Model", self.name,
+            print ": only binary linear models can be exported"
+            sys.exit(1)
+        weights = self.model.coef_[0]
+        means = getattr(self.standardizer, 'mean_', None)
+        scales = getattr(self.standardizer, 'scale_',
+                         getattr(self.standardizer, 'std_', None))
+        if means is None:
+            means = np.zeros(len(weights))
+        if scales is None:
+            scales = np.ones(len(weights))
+        for name, values in [('means', means), ('scales', scales),
+                             ('weights', weights),
+                             ('intercept', [self.model.intercept_[0]])]:
+            output_file.write(name + '\t' +
+                              ' '.join([repr(float(x)) for x in values]) +
+                              '\n')
+
     def save(self, filename=None):
         if filename == None:
             filename = self.name
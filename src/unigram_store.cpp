@@ -0,0 +1,408 @@
+/*
+mwer : multi-word expressions extractor
+Copyright (C) 2013  Tom Bosc
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "unigram_store.h"
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+
+#define UNIGRAM_STORE_MAGIC "mwerUNI2"
+
+namespace mwer{
+using namespace std;
+
+/**
+* @brief Header of the binary file
+*
+* It is followed by the offsets, the entries, the rows, the frequencies and
+* the names of the ids, each ended by '\0'.
+*/
+struct UnigramStoreHeader {
+	char magic[8];
+	unsigned long long source; // identity of the statistics file
+	long long nIds;
+	long long nRows;
+	long long nEntries;
+	long long namesSize;
+};
+
+
+
+UnigramStore::UnigramStore() :
+	offsetVector(1, 0),
+	indexed(false)
+{
+	refresh();
+}
+
+
+
+/**
+* @brief Point the views on the vectors
+*/
+void UnigramStore::refresh()
+{
+	indexed = false;
+	postingOffsets.clear();
+	postings.clear();
+	nIds = rowVector.size();
+	nRows = freqVector.size();
+	rows = rowVector.data();
+	freqs = freqVector.data();
+	offsets = offsetVector.data();
+	entries = entryVector.data();
+}
+
+
+
+/**
+* @brief Copy the mapped file in the vectors, before modifying the store
+*/
+void UnigramStore::detach()
+{
+	if (!file.is_open()) {
+		return;
+	}
+
+	rowVector.assign(rows, rows + nIds);
+	freqVector.assign(freqs, freqs + nRows);
+	offsetVector.assign(offsets, offsets + nRows + 1);
+	entryVector.assign(entries, entries + offsets[nRows]);
+	file.close();
+	refresh();
+}
+
+
+
+/**
+* @brief Add a type
+*
+* When a type is added again, its previous context is replaced.
+*
+* @param id id of the type
+* @param freq number of occurrences of the type in the corpus
+* @param context entries of the context, sorted by type id
+*/
+void UnigramStore::add(int id, float freq, const vector<Entry> &context)
+{
+	detach();
+
+	if (id >= (int) rowVector.size()) {
+		rowVector.resize(id + 1, -1);
+	}
+
+	rowVector[id] = freqVector.size();
+	freqVector.push_back(freq);
+	entryVector.insert(entryVector.end(), context.begin(), context.end());
+	offsetVector.push_back(entryVector.size());
+	refresh();
+}
+
+
+
+bool UnigramStore::contains(int id) const
+{
+	return id < nIds && rows[id] >= 0;
+}
+
+
+
+float UnigramStore::getFreq(int id) const
+{
+	return contains(id) ? freqs[rows[id]] : 0;
+}
+
+
+
+/**
+* @brief First entry of the context of a type
+*
+* @param id id of the type
+*
+* @return first entry, equal to contextEnd(id) if the type was not added
+*/
+const UnigramStore::Entry *UnigramStore::contextBegin(int id) const
+{
+	return contains(id) ? entries + offsets[rows[id]] : entries;
+}
+
+
+
+const UnigramStore::Entry *UnigramStore::contextEnd(int id) const
+{
+	return contains(id) ? entries + offsets[rows[id] + 1] : entries;
+}
+
+
+
+/**
+* @brief Build the inverted index of the contexts
+*
+* The index is dropped when a type is added or the store is loaded.
+*/
+void UnigramStore::buildIndex()
+{
+	int nPostingIds = 0;
+
+	for (const Entry *e = entries; e != entries + offsets[nRows]; ++e) {
+		nPostingIds = max(nPostingIds, e->first + 1);
+	}
+
+	// Counting sort of the entries of the current rows by type id : going
+	// through the owners in order, the postings are sorted by owner
+	postingOffsets.assign(nPostingIds + 1, 0);
+
+	for (int id = 0; id < nIds; ++id) {
+		for (const Entry *e = contextBegin(id); e != contextEnd(id); ++e) {
+			++postingOffsets[e->first + 1];
+		}
+	}
+
+	for (int id = 0; id < nPostingIds; ++id) {
+		postingOffsets[id + 1] += postingOffsets[id];
+	}
+
+	vector<long long> next(postingOffsets.begin(), postingOffsets.end() - 1);
+	postings.resize(postingOffsets[nPostingIds]);
+
+	for (int id = 0; id < nIds; ++id) {
+		const Entry *begin = contextBegin(id);
+		const Entry *end = contextEnd(id);
+
+		for (const Entry *e = begin; e != end; ++e) {
+			postings[next[e->first]++] = make_pair(id, e->second / (end - begin));
+		}
+	}
+
+	indexed = true;
+}
+
+
+
+bool UnigramStore::isIndexed() const
+{
+	return indexed;
+}
+
+
+
+/**
+* @brief First posting of a type, buildIndex() must have been called
+*
+* @param id id of the type
+*
+* @return first posting, equal to postingsEnd(id) if the type is in no context
+*/
+const UnigramStore::Entry *UnigramStore::postingsBegin(int id) const
+{
+	if (id + 1 >= (int) postingOffsets.size()) {
+		return postings.data();
+	}
+
+	return postings.data() + postingOffsets[id];
+}
+
+
+
+const UnigramStore::Entry *UnigramStore::postingsEnd(int id) const
+{
+	if (id + 1 >= (int) postingOffsets.size()) {
+		return postings.data();
+	}
+
+	return postings.data() + postingOffsets[id + 1];
+}
+
+
+
+/**
+* @brief Save the store in a binary file
+*
+* @param filename file to write
+* @param names string format of each id, there can be more names than ids
+* @param source identity of the statistics file the types were read from
+*
+* @return false if the file could not be written
+*/
+bool UnigramStore::save(const string &filename,
+						const vector<string> &names,
+						unsigned long long source) const
+{
+	ofstream out(filename.c_str(), ios::binary);
+	UnigramStoreHeader header;
+	memcpy(header.magic, UNIGRAM_STORE_MAGIC, sizeof(header.magic));
+	header.source = source;
+	header.nIds = names.size();
+	header.nRows = nRows;
+	header.nEntries = offsets[nRows];
+	header.namesSize = 0;
+
+	for (const string &name : names) {
+		header.namesSize += name.size() + 1;
+	}
+
+	// every id of names has a row
+	vector<int> allRows(rows, rows + nIds);
+	allRows.resize(names.size(), -1);
+
+	out.write((const char *) &header, sizeof(header));
+	out.write((const char *) offsets, sizeof(long long) * (nRows + 1));
+	out.write((const char *) entries, sizeof(Entry) * header.nEntries);
+	out.write((const char *) allRows.data(), sizeof(int) * allRows.size());
+	out.write((const char *) freqs, sizeof(float) * nRows);
+
+	for (const string &name : names) {
+		out.write(name.c_str(), name.size() + 1);
+	}
+
+	return (bool) out;
+}
+
+
+
+/**
+* @brief Load a store saved with save(), replacing the types added
+*
+* The file is mapped in memory : it must not be modified while the store is
+* used. Its tables are checked before, so that a corrupted file is rejected
+* rather than read out of bounds.
+*
+* @param filename file to map
+* @param names filled with the string format of each id
+* @param source identity of the statistics file the types must come from
+*
+* @return false if the file is not a valid store of that statistics file
+*/
+bool UnigramStore::load(const string &filename, vector<string> &names,
+						unsigned long long source)
+{
+	boost::iostreams::mapped_file_source mapped;
+
+	try {
+		mapped.open(filename);
+	} catch (exception &e) {
+		return false;
+	}
+
+	const char *data = mapped.data();
+	size_t size = mapped.size();
+	UnigramStoreHeader header;
+
+	if (size < sizeof(header)) {
+		return false;
+	}
+
+	memcpy(&header, data, sizeof(header));
+
+	if (memcmp(header.magic, UNIGRAM_STORE_MAGIC, sizeof(header.magic)) != 0 ||
+			header.source != source) {
+		return false;
+	}
+
+	// each count is bounded by the size of the file before the size of the
+	// tables is computed, so that it cannot overflow. Ids and rows are ints.
+	long long fileSize = size;
+	long long maxInt = numeric_limits<int>::max();
+
+	if (header.nIds < 0 || header.nIds > maxInt ||
+			header.nIds > fileSize / (long long) sizeof(int) ||
+			header.nRows < 0 || header.nRows >= maxInt ||
+			header.nRows >= fileSize / (long long) sizeof(long long) ||
+			header.nEntries < 0 ||
+			header.nEntries > fileSize / (long long) sizeof(Entry) ||
+			header.namesSize < 0 || header.namesSize > fileSize) {
+		return false;
+	}
+
+	size_t namesStart = sizeof(header) +
+						sizeof(long long) * (header.nRows + 1) +
+						sizeof(Entry) * header.nEntries +
+						sizeof(int) * header.nIds +
+						sizeof(float) * header.nRows;
+
+	if (namesStart + header.namesSize != size ||
+			(header.namesSize > 0 && data[size - 1] != '\0')) {
+		return false;
+	}
+
+	const char *table = data + sizeof(header);
+	const long long *fileOffsets = (const long long *) table;
+	table += sizeof(long long) * (header.nRows + 1);
+	const Entry *fileEntries = (const Entry *) table;
+	table += sizeof(Entry) * header.nEntries;
+	const int *fileRows = (const int *) table;
+	table += sizeof(int) * header.nIds;
+	const float *fileFreqs = (const float *) table;
+
+	// offsets go from 0 to nEntries, the contexts are sorted by type id, the
+	// types of the contexts have names and the rows exist
+	if (fileOffsets[0] != 0 || fileOffsets[header.nRows] != header.nEntries) {
+		return false;
+	}
+
+	for (long long r = 0; r < header.nRows; ++r) {
+		if (fileOffsets[r + 1] < fileOffsets[r]) {
+			return false;
+		}
+
+		for (long long e = fileOffsets[r]; e < fileOffsets[r + 1]; ++e) {
+			if (fileEntries[e].first < 0 || fileEntries[e].first >= header.nIds ||
+					(e > fileOffsets[r] &&
+					 fileEntries[e].first <= fileEntries[e - 1].first)) {
+				return false;
+			}
+		}
+	}
+
+	for (long long id = 0; id < header.nIds; ++id) {
+		if (fileRows[id] < -1 || fileRows[id] >= header.nRows) {
+			return false;
+		}
+	}
+
+	vector<string> storedNames;
+	storedNames.reserve(header.nIds);
+
+	for (const char *p = data + namesStart; p < data + size;
+			p += storedNames.back().size() + 1) {
+		storedNames.push_back(string(p));
+	}
+
+	if ((long long) storedNames.size() != header.nIds) {
+		return false;
+	}
+
+	file = mapped;
+	rowVector.clear();
+	freqVector.clear();
+	offsetVector.assign(1, 0);
+	entryVector.clear();
+	refresh();
+	nIds = header.nIds;
+	nRows = header.nRows;
+	offsets = fileOffsets;
+	entries = fileEntries;
+	rows = fileRows;
+	freqs = fileFreqs;
+	names.swap(storedNames);
+	return true;
+}
+}
@@ -0,0 +1,93 @@
+/*
+mwer : multi-word expressions extractor
+Copyright (C) 2013  Tom Bosc
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef UNIGRAM_STORE_H_
+#define UNIGRAM_STORE_H_
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace mwer{
+/**
+* @brief Frequencies and broad contexts of the one type candidates
+*
+* Types are referred to by id. The contexts are stored in compressed sparse
+* rows : the (type id, frequency) pairs of all contexts are stored in one
+* array, each row being the context of a type, sorted by type id.
+*
+* The inverted index gives for each type the contexts it appears in : its
+* postings are (type id, weight) pairs sorted by type id, the weight being
+* the frequency in the context of that type divided by the size of the
+* context.
+*
+* The store can be saved in a binary file, and loaded by mapping that file in
+* memory instead of reading the statistics file again. The file is in the
+* byte order of the machine, and records the identity of the statistics file
+* it comes from.
+*/
+class UnigramStore {
+	public:
+		typedef std::pair<int, float> Entry;
+
+	private:
+		// Built in memory by add()
+		std::vector<int> rowVector;
+		std::vector<float> freqVector;
+		std::vector<long long> offsetVector;
+		std::vector<Entry> entryVector;
+		// Either on the vectors or on the mapped file
+		int nIds;
+		int nRows;
+		const int *rows; // row of each id, -1 if the type was not added
+		const float *freqs; // by row
+		const long long *offsets; // nRows + 1 offsets in entries
+		const Entry *entries;
+		boost::iostreams::mapped_file_source file;
+		// Inverted index, built by buildIndex()
+		bool indexed;
+		std::vector<long long> postingOffsets; // by id
+		std::vector<Entry> postings;
+
+		void detach();
+		void refresh();
+
+	public:
+		UnigramStore();
+
+		void add(int id, float freq, const std::vector<Entry> &context);
+		bool contains(int id) const;
+		float getFreq(int id) const;
+		const Entry *contextBegin(int id) const;
+		const Entry *contextEnd(int id) const;
+		void buildIndex();
+		bool isIndexed() const;
+		const Entry *postingsBegin(int id) const;
+		const Entry *postingsEnd(int id) const;
+		bool save(const std::string &filename,
+				  const std::vector<std::string> &names,
+				  unsigned long long source) const;
+		bool load(const std::string &filename, std::vector<std::string> &names,
+				  unsigned long long source);
+};
+}
+
+#endif
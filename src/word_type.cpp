@@ -28,7 +28,9 @@ namespace mwer{
 using namespace std;
 
 WordType::WordType(std::string s) :
-	formOrLemma(s)
+	formOrLemma(s),
+	id(-1),
+	inContext(true)
 {
 }
 
@@ -36,7 +38,9 @@ WordType::WordType(std::string s) :
 
 WordType::WordType(std::string s, std::string t) :
 	formOrLemma(s),
-	tag(t)
+	tag(t),
+	id(-1),
+	inContext(true)
 {
 }
 
@@ -75,6 +79,41 @@ string &WordType::getTag()
 
 
 
+/**
+* @return Index of the type in the order of interning, or -1 if the type
+* has not been interned
+*/
+int WordType::getId() const
+{
+	return id;
+}
+
+
+
+void WordType::setId(int i)
+{
+	id = i;
+}
+
+
+
+/**
+* @return false if the type is filtered out of the contexts
+*/
+bool WordType::isInContext() const
+{
+	return inContext;
+}
+
+
+
+void WordType::setInContext(bool b)
+{
+	inContext = b;
+}
+
+
+
 size_t WordTypeHash::operator()(const WordType *t) const
 {
 	return str_hash(t->formOrLemma);
@@ -35,6 +35,8 @@ class WordType {
 	private:
 		std::string formOrLemma;
 		std::string tag;
+		int id;
+		bool inContext;
 
 	public:
 		WordType(std::string formOrLemma);
@@ -43,6 +45,10 @@ class WordType {
 
 		std::string &getFormOrLemma();
 		std::string &getTag();
+		int getId() const;
+		void setId(int id);
+		bool isInContext() const;
+		void setInContext(bool b);
 
 		bool operator< (const WordType &wt) const;
 